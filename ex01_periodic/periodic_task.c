@@ -60,6 +60,16 @@
  */
 #include <asm/io.h>		/* may be <sys/io.h> on some systems */
 
+/*
+  The speaker port isn't ours alone: the kernel's timer code writes
+  its other bits, and some change by themselves. So we can't keep a
+  shadow of it and just write, as portio.h does for ports we own, but
+  have to read it each time we change our bit, with port_modify().
+  Going through portio.h still lets the reads and writes be counted
+  and traced. See portio.h in the top-level directory.
+ */
+#include "portio.h"		/* PORT_REG, port_init(), port_modify() */
+
 /*
   Linux kernel modules in kernel versions 2.4 and later are asked to
   state their license terms.  "GPL" is the usual, for software
@@ -83,6 +93,7 @@ static RTIME sound_period_ns = 1000000;	/* timer period, in nanoseconds */
 
 #define SOUND_PORT 0x61		/* address of speaker */
 #define SOUND_MASK 0x02		/* bit to set/clear */
+static PORT_REG sound_reg;	/* the speaker port, for counting and tracing */
 
 /*
   sound_function() is our task code, executed each period. RTAI requires
@@ -93,20 +104,17 @@ static RTIME sound_period_ns = 1000000;	/* timer period, in nanoseconds */
  */
 void sound_function(int arg)
 {
-  unsigned char sound_byte;
   unsigned char toggle = 0;
 
   while (1) {
     /*
       Toggle the sound port
      */
-    sound_byte = inb(SOUND_PORT);
     if (toggle) {
-      sound_byte = sound_byte | SOUND_MASK;
+      port_modify(&sound_reg, 0, SOUND_MASK);
     } else {
-      sound_byte = sound_byte & ~SOUND_MASK;
+      port_modify(&sound_reg, SOUND_MASK, 0);
     }
-    outb(sound_byte, SOUND_PORT);
     toggle = ! toggle;
 
     /*
@@ -138,6 +146,14 @@ int init_module(void)
   RTIME timer_period_count;	/* actual timer period, in counts */
   int retval;			/* we look at our return values */
 
+  /*
+    Read the speaker port once, here, so our task never has to.
+   */
+  if (0 != portio_trace_init()) {
+    printk("can't allocate port trace\n");
+  }
+  port_init(&sound_reg, SOUND_PORT);
+
   /*
     Set up the timer to expire in pure periodic mode by calling
 
@@ -277,7 +293,13 @@ void cleanup_module(void)
   }
 
   /* turn off sound in case it was left on */
-  outb(inb(SOUND_PORT) & ~SOUND_MASK, SOUND_PORT);
+  port_modify(&sound_reg, SOUND_MASK, 0);
+  portio_trace_exit();
+
+#ifdef PORTIO_COUNT
+  printk("%s: speaker port reads/writes = %lu/%lu\n",
+	 "periodic task", sound_reg.reads, sound_reg.writes);
+#endif
 
   return;
 }
@@ -17,6 +17,7 @@
 #include <linux/sched.h>
 #include <linux/errno.h>
 #include <asm/io.h>		/* may be <sys/io.h> on some systems */
+#include "portio.h"		/* PORT_REG, port_init(), port_modify() */
 
 #include "rtai.h"
 #include "rtai_sched.h"		/* rt_set_periodic_mode(), start_rt_timer(),
@@ -53,6 +54,7 @@ static RTIME delay_period_ns = 1e9;	/* in nanoseconds, -> 1 Hz */
 
 #define SOUND_PORT 0x61		/* address of speaker */
 #define SOUND_MASK 0x02		/* bit to set/clear */
+static PORT_REG sound_reg;	/* the speaker port, for counting and tracing */
 
 /*
   delay_count is an integer shared between the two tasks that sets the
@@ -70,7 +72,6 @@ static int delay_count = 2;
  void sound_function(int arg)
  {
    int delay_left = delay_count;	/* decremented each cycle */
-   unsigned char sound_byte;
    unsigned char toggle = 0;
 
    while (1) {
@@ -84,13 +85,11 @@ static int delay_count = 2;
        delay_left--;
      } else {
        /* else it's time to toggle */
-       sound_byte = inb(SOUND_PORT);
        if (toggle) {
-	 sound_byte = sound_byte | SOUND_MASK;
+	 port_modify(&sound_reg, 0, SOUND_MASK);
        } else {
-	 sound_byte = sound_byte & ~SOUND_MASK;
+	 port_modify(&sound_reg, SOUND_MASK, 0);
        }
-       outb(sound_byte, SOUND_PORT);
        toggle = ! toggle;
        delay_left = delay_count;	/* reload our delay */
      }
@@ -132,6 +131,11 @@ int init_module(void)
   RTIME timer_period_count;
   int retval;			
 
+  if (0 != portio_trace_init()) {
+    printk("can't allocate port trace\n");
+  }
+  port_init(&sound_reg, SOUND_PORT);
+
   rt_set_periodic_mode();
 
   /*
@@ -261,7 +265,13 @@ void cleanup_module(void)
   }
 
   /* turn off sound in case it was left on */
-  outb(inb(SOUND_PORT) & ~SOUND_MASK, SOUND_PORT);
+  port_modify(&sound_reg, SOUND_MASK, 0);
+  portio_trace_exit();
+
+#ifdef PORTIO_COUNT
+  printk("%s: speaker port reads/writes = %lu/%lu\n",
+	 "sound task", sound_reg.reads, sound_reg.writes);
+#endif
 
   return;
 }
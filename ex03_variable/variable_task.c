@@ -14,6 +14,7 @@
 #include <linux/sched.h>
 #include <linux/errno.h>	/* EINVAL, ENOMEM */
 #include <asm/io.h>		/* inb(), outb(), may be <sys/io.h> */
+#include "portio.h"		/* PORT_REG, port_init(), port_modify() */
 #include "rtai.h"		/* RTAI configuration switches */
 #include "rtai_sched.h"		/* rt_set_oneshot_mode(), start_rt_timer(),
 				   nano2count(), RT_LOWEST_PRIORITY,
@@ -48,6 +49,7 @@ static RTIME increment_ns = 1e4; /* period change */
 
 #define SOUND_PORT 0x61		/* address of speaker */
 #define SOUND_MASK 0x02		/* bit to set/clear */
+static PORT_REG sound_reg;	/* the speaker port, for counting and tracing */
 
 /*
   sound_function() linearly varies its period to sweep through a
@@ -67,7 +69,6 @@ static RTIME increment_ns = 1e4; /* period change */
  */
 void sound_function(int initial_period_count)
 {
-  unsigned char sound_byte;
   unsigned char toggle = 0;
   unsigned char freq_up = 0; /* lets us sweep frequency down and up */
   RTIME delay;			/* variable intertask period */
@@ -85,13 +86,11 @@ void sound_function(int initial_period_count)
     start = rt_get_time();
 
     /* Toggle the sound port */
-    sound_byte = inb(SOUND_PORT);
     if (toggle) {
-      sound_byte = sound_byte | SOUND_MASK;
+      port_modify(&sound_reg, 0, SOUND_MASK);
     } else {
-      sound_byte = sound_byte & ~SOUND_MASK;
+      port_modify(&sound_reg, SOUND_MASK, 0);
     }
-    outb(sound_byte, SOUND_PORT);
     toggle = ! toggle;
 
     /* Vary the delay */
@@ -161,6 +160,11 @@ int init_module(void)
   RTIME sound_period_count;	/* requested timer period, in counts */
   int retval;			/* we look at our return values */
 
+  if (0 != portio_trace_init()) {
+    printk("can't allocate port trace\n");
+  }
+  port_init(&sound_reg, SOUND_PORT);
+
   /*
     Set up the timer to expire in one-shot mode by calling
 
@@ -258,7 +262,13 @@ void cleanup_module(void)
   }
 
   /* turn off sound in case it was left on */
-  outb(inb(SOUND_PORT) & ~SOUND_MASK, SOUND_PORT);
+  port_modify(&sound_reg, SOUND_MASK, 0);
+  portio_trace_exit();
+
+#ifdef PORTIO_COUNT
+  printk("%s: speaker port reads/writes = %lu/%lu\n",
+	 "variable task", sound_reg.reads, sound_reg.writes);
+#endif
 
   return;
 }
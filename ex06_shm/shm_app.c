@@ -38,6 +38,18 @@
   will be done, 10 milliseconds typically. This gives the writer a
   chance.
 
+  Before running, the shared memory is prefaulted and locked so that
+  the reads don't take page faults on first access. If the environment
+  variable SHM_HUGE is set, huge pages are requested too. The page
+  fault counts before and after prefaulting, and during the run, are
+  printed at the end.
+
+  If you pass a third argument, e.g., './shm_app ARG ARG ARG', the
+  incremental technique will be used. Here the writer changes only one
+  block of the data array each cycle, and only changed blocks are
+  copied by either side. Since the data array is no longer all the
+  same value, consistency is checked block by block.
+
   Performance numbers are printed out at the end, depending upon which
   method is selected, e.g.,
 
@@ -75,6 +87,9 @@
 */
 
 #include <stdio.h>		/* printf() */
+#include <stdlib.h>		/* getenv() */
+#include <string.h>		/* memset() */
+#include <unistd.h>		/* usleep() */
 #include <stddef.h>		/* sizeof() */
 #include <signal.h>		/* signal(), SIGINT */
 #include <sys/mman.h>		/* PROT_READ, needed for rtai_shm.h */
@@ -82,6 +97,7 @@
 #include <sys/fcntl.h>		/* O_RDWR, needed for rtai_shm.h */
 #include <rtai_shm.h>		/* rtai_malloc,free() */
 #include "shm_core.h"		/* SHM_KEY, SHM_HOWMANY */
+#include "prefault.h"		/* prefault(), page_faults() */
 
 /*
   This signal handler just sets the 'done' flag, which we will loop
@@ -96,6 +112,7 @@ static void quit(int sig)
 int main(int argc, char *argv[])
 {
   int t;
+  SHM_SEGMENT * shm_seg;
   SHM_STRUCT * shm_ptr;
   SHM_STRUCT shm_copy;
   int come_back;		/* persistent flag, for some algos */
@@ -104,21 +121,65 @@ int main(int argc, char *argv[])
   int inconsistent;		/* how many good reads really had bad data */
   int made_writes;		/* copy of last valid made writes, from shm */
   int missed_writes;		/* copy of last valid missed writes */
+  int block_check;		/* check consistency only within blocks */
+  long faults_start;		/* page faults before prefaulting */
+  long faults_prefault;		/* page faults after prefaulting */
   MUTEX_READ_FUNC algo_ptr = peterson_read;
 
-  shm_ptr = rtai_malloc(SHM_KEY, SHM_HOWMANY * sizeof(int));
-  if (0 == shm_ptr) {
+  shm_seg = rtai_malloc(SHM_KEY, sizeof(SHM_SEGMENT));
+  if (0 == shm_seg) {
     fprintf(stderr, "can't allocate shared memory\n");
     return 1;
   }
 
+  /*
+    Wait a little while for the writer to say it's ready, in case
+    we were started first, then make sure it laid out the memory the
+    way we expect.
+   */
+  t = shm_header_wait(&shm_seg->header, SHM_MAGIC, 1000);
+  if (t < 0) {
+    fprintf(stderr, "shared memory has no header, is shm_mod loaded?\n");
+    rtai_free(SHM_KEY, shm_seg);
+    return 1;
+  }
+  if (t > 0) {
+    fprintf(stderr, "shared memory not ready\n");
+    rtai_free(SHM_KEY, shm_seg);
+    return 1;
+  }
+  if (0 != shm_header_check(&shm_seg->header, SHM_MAGIC, SHM_VERSION,
+			    sizeof(SHM_STRUCT), SHM_HOWMANY)) {
+    fprintf(stderr, "shared memory is version %u, size %u, %u elements, "
+	    "expected version %d, size %d, %d elements\n",
+	    shm_seg->header.version, shm_seg->header.size,
+	    shm_seg->header.howmany,
+	    SHM_VERSION, (int) sizeof(SHM_STRUCT), SHM_HOWMANY);
+    rtai_free(SHM_KEY, shm_seg);
+    return 1;
+  }
+  shm_ptr = &shm_seg->shm;
+
+  /*
+    Take the page faults now, rather than in the middle of a read.
+   */
+  faults_start = page_faults();
+  if (0 != prefault(shm_seg, sizeof(SHM_SEGMENT), NULL != getenv("SHM_HUGE"))) {
+    fprintf(stderr, "can't lock shared memory, continuing\n");
+  }
+  faults_prefault = page_faults();
+
   /*
     Attach our signal hander to SIGINT, the signal raised when we hit
     Control-C.
    */
   signal(SIGINT, quit);
 
-  if (argc > 2) {
+  block_check = 0;
+  if (argc > 3) {
+    algo_ptr = incremental_read;
+    block_check = 1;
+  } else if (argc > 2) {
     algo_ptr = head_tail_read;
   } else if (argc > 1) {
     algo_ptr = test_and_set_read;
@@ -130,12 +191,17 @@ int main(int argc, char *argv[])
   inconsistent = 0;
   made_writes = 0;
   missed_writes = 0;
+  /* the incremental reader needs to start with zeroed block versions */
+  memset(&shm_copy, 0, sizeof(shm_copy));
 
   while (! done) {
     if (0 == (*algo_ptr)(shm_ptr, &shm_copy, &come_back)) {
       made_reads++;
       /* check for consistent data */
       for (t = 0; t < SHM_HOWMANY - 1; t++) {
+	if (block_check && 0 == (t + 1) % SHM_BLOCK_SIZE) {
+	  continue;		/* next one starts a new block */
+	}
 	if (shm_copy.data[t] != shm_copy.data[t + 1]) {
 	  made_reads--;
 	  inconsistent++;
@@ -159,8 +225,10 @@ int main(int argc, char *argv[])
 	 made_reads, missed_reads, inconsistent);
   printf("writes made/missed:             %d/%d\n",
 	 made_writes, missed_writes);
+  printf("page faults prefault/run:       %ld/%ld\n",
+	 faults_prefault - faults_start, page_faults() - faults_prefault);
 
-  rtai_free(SHM_KEY, shm_ptr);
+  rtai_free(SHM_KEY, shm_seg);
 
   return 0;
 }
@@ -217,3 +217,102 @@ int head_tail_write(SHM_STRUCT * shm_copy, SHM_STRUCT * shm_ptr, int * come_back
 
   return 0;
 }
+
+/*
+  The incremental technique is a variation on head/tail flags for large
+  data that changes only a little each cycle. Rather than copying the
+  whole data array, the writer keeps a bitmap of the blocks it has
+  changed in its local copy, via shm_set_data(), and copies only those
+  into shared memory. Each block copied is stamped with a new version
+  number.
+
+  The reader keeps the block versions of its last snapshot in its own
+  copy, and copies only those blocks whose version in shared memory
+  differs. The head/tail counts bracket the whole thing as before, so
+  a read that was split by a write is detected and should be discarded.
+
+  The reader copies each block's version before its data. If a write
+  splits the read, the version saved is never newer than the data
+  saved, so the next read picks up the block again. This means the
+  reader's copy is always consistent after a read that returns 0, and
+  the reader must hold on to its copy between calls. The reader's copy
+  should be zeroed before the first call, to match the zeroed shared
+  memory.
+ */
+
+void shm_set_data(SHM_STRUCT * shm_copy, int index, int value)
+{
+  int block;
+
+  shm_copy->data[index] = value;
+  block = index / SHM_BLOCK_SIZE;
+  shm_copy->dirty[block / 32] |= 1U << (block % 32);
+}
+
+/* copies block 'block' of the data array from 'src' to 'dst' */
+static void copy_block(SHM_STRUCT * src, SHM_STRUCT * dst, int block)
+{
+  int t, end;
+
+  end = (block + 1) * SHM_BLOCK_SIZE;
+  if (end > SHM_HOWMANY) {
+    end = SHM_HOWMANY;
+  }
+  for (t = block * SHM_BLOCK_SIZE; t < end; t++) {
+    dst->data[t] = src->data[t];
+  }
+}
+
+int incremental_read(SHM_STRUCT * shm_ptr, SHM_STRUCT * shm_copy, int * come_back)
+{
+  int b;
+  unsigned int version;
+
+  shm_copy->head = shm_ptr->head;
+  for (b = 0; b < SHM_BLOCKS; b++) {
+    version = shm_ptr->block_version[b];
+    if (version != shm_copy->block_version[b]) {
+      shm_copy->block_version[b] = version;
+      copy_block(shm_ptr, shm_copy, b);
+    }
+  }
+  shm_copy->version = shm_ptr->version;
+  shm_copy->made_writes = shm_ptr->made_writes;
+  shm_copy->missed_writes = shm_ptr->missed_writes;
+  shm_copy->tail = shm_ptr->tail;
+
+  if (shm_copy->head != shm_copy->tail) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int incremental_write(SHM_STRUCT * shm_copy, SHM_STRUCT * shm_ptr, int * come_back)
+{
+  int w, b;
+  unsigned int dirty;
+  unsigned int version;
+
+  shm_ptr->head++;
+  version = shm_ptr->version + 1;
+  for (w = 0; w < SHM_DIRTY_WORDS; w++) {
+    dirty = shm_copy->dirty[w];
+    if (0 == dirty) {
+      continue;
+    }
+    for (b = w * 32; dirty != 0; b++, dirty >>= 1) {
+      if (dirty & 1) {
+	copy_block(shm_copy, shm_ptr, b);
+	shm_ptr->block_version[b] = version;
+      }
+    }
+    shm_copy->dirty[w] = 0;
+  }
+  shm_ptr->version = version;
+  shm_ptr->made_writes = shm_copy->made_writes;
+  shm_ptr->missed_writes = shm_copy->missed_writes;
+  shm_ptr->tail = shm_ptr->head;
+
+  return 0;
+}
@@ -8,8 +8,20 @@
   that will be used for data consistency.
  */
 
+#include "shm_header.h"		/* SHM_HEADER */
+
 #define SHM_HOWMANY 1000	/* the bigger, the more time-consuming */
 
+/*
+  For the INCREMENTAL technique, the data array is divided into blocks
+  of SHM_BLOCK_SIZE elements. The writer marks blocks dirty as it
+  changes them, and only dirty blocks are copied into shared memory.
+  The last block may be partially filled.
+ */
+#define SHM_BLOCK_SIZE 64
+#define SHM_BLOCKS ((SHM_HOWMANY + SHM_BLOCK_SIZE - 1) / SHM_BLOCK_SIZE)
+#define SHM_DIRTY_WORDS ((SHM_BLOCKS + 31) / 32)
+
 typedef struct {
   unsigned char head;		/* for the HEAD_TAIL technique */
   unsigned char reader;		/* for the PETERSON technique */
@@ -20,12 +32,30 @@ typedef struct {
   int made_writes;		/* how many writes the writer made */
   int missed_writes;		/* how many writes the writer missed */
   unsigned char tail;		/* for the HEAD_TAIL technique */
+  unsigned int version;		/* for the INCREMENTAL technique */
+  unsigned int block_version[SHM_BLOCKS]; /* ditto, version of each block */
+  unsigned int dirty[SHM_DIRTY_WORDS]; /* ditto, writer's dirty bitmap */
 } SHM_STRUCT;
 
 #define SHM_KEY 101		/* shared key, arbitrary value */
 
+/*
+  The shared memory segment begins with a header that describes what
+  follows, so that a reader can check that it agrees with the writer
+  on the layout before using it; see shm_header.h in the top-level
+  directory. If the data structure changes, bump SHM_VERSION so that
+  old readers will refuse to attach rather than reading garbage.
+ */
+#define SHM_MAGIC 0x53484D30	/* "SHM0" */
+#define SHM_VERSION 1
+
+typedef struct {
+  SHM_HEADER header;		/* SHM_MAGIC, SHM_VERSION, sizeof(SHM_STRUCT) */
+  SHM_STRUCT shm;
+} SHM_SEGMENT;
+
 /* which algorithm will be used */
-enum {PETERSON = 1, TEST_AND_SET = 2, HEAD_TAIL = 3};
+enum {PETERSON = 1, TEST_AND_SET = 2, HEAD_TAIL = 3, INCREMENTAL = 4};
 
 /*
   Function pointer declarations. We will declare a reader function and
@@ -48,4 +78,13 @@ extern int test_and_set_write(SHM_STRUCT * shm_copy, SHM_STRUCT * shm_ptr, int *
 extern int head_tail_read(SHM_STRUCT * shm_ptr, SHM_STRUCT * shm_copy, int * come_back);
 extern int head_tail_write(SHM_STRUCT * shm_copy, SHM_STRUCT * shm_ptr, int * come_back);
 
+extern int incremental_read(SHM_STRUCT * shm_ptr, SHM_STRUCT * shm_copy, int * come_back);
+extern int incremental_write(SHM_STRUCT * shm_copy, SHM_STRUCT * shm_ptr, int * come_back);
+
+/*
+  shm_set_data() sets one element of the writer's local copy and marks
+  its block dirty, so that the next incremental_write() will publish it.
+ */
+extern void shm_set_data(SHM_STRUCT * shm_copy, int index, int value);
+
 #endif /* SHM_COMMON_H */
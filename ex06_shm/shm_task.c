@@ -23,6 +23,7 @@
 #include <linux/sched.h>
 #include <linux/errno.h>	/* ENOMEM */
 #include <linux/moduleparam.h>
+#include <linux/string.h>	/* memset() */
 #include <stddef.h>		/* sizeof() */
 #include "rtai.h"
 #include "rtai_sched.h"
@@ -56,7 +57,8 @@ RT_TASK shm_task;
 
 static RTIME shm_period_ns = 100000;
 
-static SHM_STRUCT * shm_ptr = 0; /* pointer to shared memory */
+static SHM_SEGMENT * shm_seg = 0; /* pointer to shared memory */
+static SHM_STRUCT * shm_ptr = 0; /* pointer to the data within it */
 
 /*
   To allow arguments to be passed to your module, declare the variables
@@ -149,11 +151,18 @@ static void shm_writer(int arg)
   SHM_STRUCT shm_copy;
   int come_back;		/* persistent flag, needed for some algos */
   int heartbeat;		/* we increment this and fill the data array */
+  int block;			/* which block we change, for INCREMENTAL */
   int t;
 
   come_back = 0;
   heartbeat = 0;
 
+  /*
+    The incremental technique relies on our copy persisting from cycle
+    to cycle, with a clean dirty bitmap to start.
+   */
+  memset(&shm_copy, 0, sizeof(shm_copy));
+
   /*
     In this writer code, we just reference the shared memory pointer
     as we would any other pointer. Here we increment a heartbeat that
@@ -163,8 +172,20 @@ static void shm_writer(int arg)
    */
   while (1) {
     heartbeat++;
-    for (t = 0; t < SHM_HOWMANY; t++) {
-      shm_copy.data[t] = heartbeat;
+    if (WHICH_ALGO == INCREMENTAL) {
+      /*
+	Change just one block each cycle, as a sparse update would.
+	Only this block will be copied into shared memory.
+       */
+      block = heartbeat % SHM_BLOCKS;
+      for (t = block * SHM_BLOCK_SIZE;
+	   t < (block + 1) * SHM_BLOCK_SIZE && t < SHM_HOWMANY; t++) {
+	shm_set_data(&shm_copy, t, heartbeat);
+      }
+    } else {
+      for (t = 0; t < SHM_HOWMANY; t++) {
+	shm_copy.data[t] = heartbeat;
+      }
     }
     shm_copy.made_writes = made_writes;
     shm_copy.missed_writes = missed_writes;
@@ -193,12 +214,17 @@ int init_module(void)
     void * rtai_kmalloc(int key, size_t size);
 
     which takes an integer 'key' agreed to by all memory sharers, and
-    the size of shared memory, and returns a pointer to it.
+    the size of shared memory, and returns a pointer to it. Our
+    segment is a header describing the layout, followed by the data
+    structure itself.
   */
-  shm_ptr = rtai_kmalloc(SHM_KEY, SHM_HOWMANY * sizeof(int));
-  if (0 == shm_ptr) {
+  shm_seg = rtai_kmalloc(SHM_KEY, sizeof(SHM_SEGMENT));
+  if (0 == shm_seg) {
     return -ENOMEM;		/* can't get memory-- perhaps too big */
   }
+  shm_header_init(&shm_seg->header, SHM_MAGIC, SHM_VERSION,
+		  sizeof(SHM_STRUCT), SHM_HOWMANY);
+  shm_ptr = &shm_seg->shm;
 
   /* initialize shared memory */
   shm_ptr->head = 0;
@@ -212,12 +238,21 @@ int init_module(void)
   shm_ptr->made_writes = 0;
   shm_ptr->missed_writes = 0;
   shm_ptr->tail = 0;
+  shm_ptr->version = 0;
+  for (t = 0; t < SHM_BLOCKS; t++) {
+    shm_ptr->block_version[t] = 0;
+  }
+
+  /* say we're ready last */
+  shm_header_ready(&shm_seg->header);
 
   /* set up algorithm pointer */
   if (WHICH_ALGO == TEST_AND_SET) {
     algo_ptr = test_and_set_write;
   } else if (WHICH_ALGO == HEAD_TAIL) {
     algo_ptr = head_tail_write;
+  } else if (WHICH_ALGO == INCREMENTAL) {
+    algo_ptr = incremental_write;
   } /* else leave it at peterson */
   
   /*
@@ -248,6 +283,8 @@ void cleanup_module(void)
 {
   rt_task_delete(&shm_task);
 
+  shm_seg->header.ready = 0;
+
   /*
     Free up the shared memory by calling
 
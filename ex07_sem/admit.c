@@ -0,0 +1,285 @@
+/*
+  admit.c
+
+  Overrun accounting and admission control for periodic RTAI tasks.
+
+  Admission control keeps the total utilization of the tasks on each
+  CPU, the sum of budget/period, from going over 100%, past which some
+  task must miss its deadlines no matter how they're scheduled. Below
+  that, fixed-priority scheduling with rate-monotonic priorities
+  (faster tasks get higher priority) is guaranteed to meet all
+  deadlines if utilization is below the Liu and Layland bound,
+  n(2^(1/n) - 1) for n tasks. Between the bound and 100% it may or may
+  not, so we admit the task but say so.
+
+  Utilizations are computed in parts per thousand, with times in
+  microseconds, so we can stick to integer arithmetic in the kernel.
+
+  The time a cycle takes is measured from admit_cycle_start() to
+  admit_cycle_end(), so it includes any time the task was preempted
+  by higher-priority tasks; RTAI doesn't tell us how much of it the
+  task itself ran. That's the response time, which is what matters for
+  overruns, but it's more than the execution time that the budget is
+  meant to be, so we don't raise the budget from it, except when
+  DEGRADE_OVERRUN has to pick a new period that will fit.
+
+  When SKIP_OVERRUN or DEGRADE_OVERRUN moves a task's periods, it
+  calls rt_task_make_periodic() with a start time one period before
+  the next release, which is already past, so the task isn't held up
+  there, and the caller's rt_task_wait_period() then sleeps until the
+  release itself. That way the release we record is the one the task
+  really wakes up at, and a single overrun is counted just once.
+*/
+
+#include <linux/kernel.h>
+#include <linux/errno.h>	/* ENOSPC, EBUSY */
+#include <asm/div64.h>		/* do_div() */
+#include "rtai.h"
+#include "rtai_sched.h"
+#include "admit.h"
+
+static ADMIT_TASK * admitted[ADMIT_MAX_TASKS] = {0};
+
+/*
+  The Liu and Layland bound, in parts per thousand, for 1, 2, ... tasks.
+  It approaches ln 2, or 693, for many tasks.
+ */
+static int rm_bound[] = {1000, 828, 779, 756, 743, 734, 728, 724};
+#define RM_BOUND(n) ((n) <= sizeof(rm_bound)/sizeof(rm_bound[0]) ? rm_bound[(n) - 1] : 693)
+
+/*
+  Returns a * b / c, rounded up, for non-negative a, b and positive c,
+  without overflow or 64-bit division, which isn't available in all
+  kernels.
+ */
+static long muldiv(long a, long b, long c)
+{
+  unsigned long long n = (unsigned long long) a * b;
+
+  if (do_div(n, c)) {
+    n++;
+  }
+
+  return (long) n;
+}
+
+/* converts nanoseconds to microseconds, ditto */
+static long ns_to_us(RTIME ns)
+{
+  unsigned long long n = ns;
+
+  do_div(n, 1000);
+
+  return (long) n;
+}
+
+int admit_task_init(ADMIT_TASK * at, RT_TASK * task, const char * name,
+		    int cpu, RTIME budget_ns, int policy)
+{
+  int t;
+
+  at->name = name;
+  at->task = task;
+  at->cpu = cpu;
+  at->policy = policy;
+  at->budget_us = ns_to_us(budget_ns);
+  at->period_us = 0;
+  at->period_count = 0;
+  at->release = 0;
+  at->start = 0;
+  at->exec_max = 0;
+  at->cycles = 0;
+  at->overruns = 0;
+  at->skipped = 0;
+  at->degraded = 0;
+  at->refused = 0;
+
+  for (t = 0; t < ADMIT_MAX_TASKS; t++) {
+    if (0 == admitted[t]) {
+      admitted[t] = at;
+      return 0;
+    }
+  }
+
+  return -ENOSPC;
+}
+
+void admit_task_delete(ADMIT_TASK * at)
+{
+  int t;
+
+  for (t = 0; t < ADMIT_MAX_TASKS; t++) {
+    if (at == admitted[t]) {
+      admitted[t] = 0;
+    }
+  }
+}
+
+/*
+  Returns the utilization of the other admitted tasks on 'at's CPU, in
+  parts per thousand, and the number of them in 'num'.
+ */
+static long others_utilization(ADMIT_TASK * at, int * num)
+{
+  ADMIT_TASK * other;
+  long util;
+  int t;
+
+  util = 0;
+  *num = 0;
+  for (t = 0; t < ADMIT_MAX_TASKS; t++) {
+    other = admitted[t];
+    if (0 == other || other == at || other->cpu != at->cpu ||
+	other->period_us <= 0) {
+      continue;
+    }
+    util += muldiv(1000, other->budget_us, other->period_us);
+    (*num)++;
+  }
+
+  return util;
+}
+
+/*
+  Checks admission for 'at' at 'period' counts, and records the new
+  period if admitted. We may be called from an RT task, so we use
+  rt_printk() for messages.
+ */
+static int admit_check(ADMIT_TASK * at, RTIME period)
+{
+  long period_us;
+  long util;
+  int num;
+
+  period_us = ns_to_us(count2nano(period));
+  if (period_us <= 0) {
+    period_us = 1;
+  }
+
+  util = others_utilization(at, &num) + muldiv(1000, at->budget_us, period_us);
+  num++;
+  if (util > 1000) {
+    rt_printk("admit: %s at %ld usecs would load CPU %d to %ld.%ld%%, "
+	      "not admitted\n", at->name, period_us, at->cpu,
+	      util / 10, util % 10);
+    return -EBUSY;
+  }
+  if (util > RM_BOUND(num)) {
+    rt_printk("admit: %s at %ld usecs loads CPU %d to %ld.%ld%%, "
+	      "over the %d.%d%% bound for %d tasks, deadlines may be missed\n",
+	      at->name, period_us, at->cpu, util / 10, util % 10,
+	      RM_BOUND(num) / 10, RM_BOUND(num) % 10, num);
+  }
+
+  at->period_us = period_us;
+  at->period_count = period;
+
+  return 0;
+}
+
+int admit_make_periodic(ADMIT_TASK * at, RTIME start_time, RTIME period)
+{
+  int retval;
+
+  retval = admit_check(at, period);
+  if (0 != retval) {
+    return retval;
+  }
+
+  at->release = start_time;
+
+  return rt_task_make_periodic(at->task, start_time, period);
+}
+
+void admit_cycle_start(ADMIT_TASK * at)
+{
+  at->start = rt_get_time();
+}
+
+void admit_cycle_end(ADMIT_TASK * at)
+{
+  RTIME now, exec, next;
+  long exec_us, period_us, others;
+  int num;
+
+  now = rt_get_time();
+  exec = now - at->start;
+  if (exec > at->exec_max) {
+    at->exec_max = exec;
+  }
+  at->cycles++;
+
+  next = at->release + at->period_count;
+  if (now <= next) {
+    /* on time */
+    at->release = next;
+    return;
+  }
+
+  at->overruns++;
+
+  switch (at->policy) {
+  case DEGRADE_OVERRUN:
+    /*
+      Take what this cycle took as our budget, if it's more, and
+      lengthen the period to the shortest one that fits in what the
+      other tasks leave of the CPU, starting the new period from now.
+      If nothing fits, say so once, and skip periods instead.
+     */
+    exec_us = ns_to_us(count2nano(exec));
+    if (exec_us > at->budget_us) {
+      at->budget_us = exec_us;
+    }
+    others = others_utilization(at, &num);
+    if (others < 1000) {
+      period_us = muldiv(1000, at->budget_us, 1000 - others);
+      if (period_us > at->period_us &&
+	  0 == admit_check(at, nano2count((RTIME) period_us * 1000))) {
+	at->degraded++;
+	rt_printk("admit: %s overran, period now %ld usecs\n",
+		  at->name, at->period_us);
+	at->release = now + at->period_count;
+	rt_task_make_periodic(at->task, now, at->period_count);
+	break;
+      }
+    }
+    if (! at->refused) {
+      rt_printk("admit: %s overran and can't be slowed down to fit, "
+		"skipping periods\n", at->name);
+      at->refused = 1;		/* so we don't say this again */
+    }
+    /* fall through */
+
+  case SKIP_OVERRUN:
+    /*
+      Step over the periods we've missed, without dividing, and start
+      again at the first boundary still ahead of us.
+     */
+    while (next < now) {
+      next += at->period_count;
+      at->skipped++;
+    }
+    at->release = next;
+    rt_task_make_periodic(at->task, next - at->period_count,
+			  at->period_count);
+    break;
+
+  case CATCH_UP_OVERRUN:
+  default:
+    /*
+      rt_task_wait_period() will return right away for each period
+      we've missed, so just keep track of where we are.
+     */
+    at->release = next;
+    break;
+  }
+}
+
+void admit_report(ADMIT_TASK * at)
+{
+  printk("%s: period %ld usecs, budget %ld usecs, longest response %ld usecs\n",
+	 at->name, at->period_us, at->budget_us,
+	 ns_to_us(count2nano(at->exec_max)));
+  printk("%s: cycles/overruns/skipped/degraded = %d/%d/%d/%d\n",
+	 at->name, at->cycles, at->overruns, at->skipped, at->degraded);
+}
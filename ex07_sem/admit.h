@@ -0,0 +1,89 @@
+#ifndef ADMIT_H
+#define ADMIT_H
+
+/*
+  admit.h
+
+  Declarations for overrun accounting and admission control of
+  periodic RTAI tasks. Each periodic task gets an ADMIT_TASK that
+  records its period, its execution time budget and what to do when
+  it overruns. Making a task periodic, or changing its period, first
+  checks that all the tasks on its CPU can still meet their deadlines.
+ */
+
+#include "rtai.h"
+#include "rtai_sched.h"		/* RT_TASK, RTIME */
+
+/*
+  What to do when a cycle's work runs past the start of the next
+  period:
+
+  SKIP_OVERRUN drops the periods that were missed and starts again on
+  the next period boundary that hasn't passed.
+
+  CATCH_UP_OVERRUN runs the missed periods back to back until the task
+  is back on schedule. This is what RTAI does if you do nothing.
+
+  DEGRADE_OVERRUN lengthens the period to fit the time the cycle took,
+  so the task runs less often but keeps up, and rechecks admission.
+  The time the cycle took includes any preemption, so a task that's
+  only late because higher-priority tasks ran will be slowed down too.
+ */
+enum {SKIP_OVERRUN = 1, CATCH_UP_OVERRUN = 2, DEGRADE_OVERRUN = 3};
+
+enum {ADMIT_MAX_TASKS = 16};
+
+typedef struct {
+  const char * name;		/* for messages */
+  RT_TASK * task;		/* the task being accounted for */
+  int cpu;			/* which CPU it runs on */
+  int policy;			/* one of the _OVERRUN values */
+  long budget_us;		/* expected worst-case execution time */
+  long period_us;		/* period, 0 if not admitted */
+  RTIME period_count;		/* period, in counts */
+  RTIME release;		/* when the current cycle was released */
+  RTIME start;			/* when the current cycle started running */
+  RTIME exec_max;		/* longest response, start to end, in counts */
+  int cycles;			/* how many cycles were run */
+  int overruns;			/* how many ran into the next period */
+  int skipped;			/* periods dropped by SKIP_OVERRUN */
+  int degraded;			/* times DEGRADE_OVERRUN lengthened the period */
+  int refused;			/* non-zero if DEGRADE_OVERRUN couldn't */
+} ADMIT_TASK;
+
+/*
+  admit_task_init() sets up 'at' for 'task', which runs on 'cpu', takes
+  at most 'budget_ns' nanoseconds each period, and handles overruns
+  according to 'policy'. Returns 0 if OK, -ENOSPC if too many tasks.
+  admit_task_delete() removes it from admission control.
+ */
+extern int admit_task_init(ADMIT_TASK * at, RT_TASK * task, const char * name,
+			   int cpu, RTIME budget_ns, int policy);
+extern void admit_task_delete(ADMIT_TASK * at);
+
+/*
+  admit_make_periodic() checks whether the task can run at 'period'
+  counts along with the other admitted tasks on its CPU, and if so
+  calls rt_task_make_periodic() with 'start_time' and 'period'.
+  Returns 0 if admitted, -EBUSY if the CPU would be overloaded, or
+  what rt_task_make_periodic() returns.
+ */
+extern int admit_make_periodic(ADMIT_TASK * at, RTIME start_time,
+			       RTIME period);
+
+/*
+  Call admit_cycle_start() at the beginning of each cycle's work, and
+  admit_cycle_end() at the end, just before rt_task_wait_period().
+  The end call counts overruns and applies the overrun policy, leaving
+  the task's periods set so that the rt_task_wait_period() after it
+  wakes the task at the next release.
+ */
+extern void admit_cycle_start(ADMIT_TASK * at);
+extern void admit_cycle_end(ADMIT_TASK * at);
+
+/*
+  admit_report() prints the accounting for the task.
+ */
+extern void admit_report(ADMIT_TASK * at);
+
+#endif /* ADMIT_H */
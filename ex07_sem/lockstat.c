@@ -0,0 +1,253 @@
+/*
+  lockstat.c
+
+  Lock statistics for RTAI semaphores, similar in spirit to the Linux
+  kernel's lock_stat. Each take and give of an instrumented semaphore
+  reads the CPU time twice and updates a few counters belonging to the
+  calling task on the current CPU, so it's cheap enough to leave on.
+
+  The statistics are printed by reading /proc/rtai_lockstat, e.g.,
+
+  cat /proc/rtai_lockstat
+
+  The counters are updated by RT tasks while Linux reads them, so a
+  line may occasionally mix old and new values. They're statistics,
+  so we live with it rather than slow down the RT tasks.
+*/
+
+#include <linux/kernel.h>
+#include <linux/errno.h>	/* ENOSPC, ENOMEM */
+#include <linux/string.h>	/* memset() */
+#include <linux/proc_fs.h>	/* create_proc_read_entry() */
+#include <asm/page.h>		/* PAGE_SIZE */
+#include "rtai.h"
+#include "rtai_sched.h"
+#include "rtai_sem.h"
+#include "lockstat.h"
+
+#define LOCKSTAT_PROC_NAME "rtai_lockstat"
+
+static LOCKSTAT * locks[LOCKSTAT_MAX_LOCKS] = {0};
+static int proc_created = 0;
+
+/*
+  Registered tasks get the first slots, and the last slot is for
+  everyone else.
+ */
+static RT_TASK * tasks[LOCKSTAT_MAX_TASKS - 1] = {0};
+static const char * task_names[LOCKSTAT_MAX_TASKS - 1] = {0};
+static int task_num = 0;
+
+int lockstat_init(LOCKSTAT * ls, const char * name)
+{
+  int t;
+
+  memset(ls, 0, sizeof(*ls));
+  ls->name = name;
+
+  for (t = 0; t < LOCKSTAT_MAX_LOCKS; t++) {
+    if (0 == locks[t]) {
+      locks[t] = ls;
+      return 0;
+    }
+  }
+
+  return -ENOSPC;
+}
+
+void lockstat_delete(LOCKSTAT * ls)
+{
+  int t;
+
+  for (t = 0; t < LOCKSTAT_MAX_LOCKS; t++) {
+    if (ls == locks[t]) {
+      locks[t] = 0;
+    }
+  }
+}
+
+int lockstat_task_register(RT_TASK * task, const char * name)
+{
+  if (task_num >= LOCKSTAT_MAX_TASKS - 1) {
+    return -ENOSPC;
+  }
+
+  task_names[task_num] = name;
+  tasks[task_num] = task;
+  task_num++;
+
+  return 0;
+}
+
+/* returns the counts slot for the calling task */
+static int task_slot(void)
+{
+  RT_TASK * me;
+  int t;
+
+  me = rt_whoami();
+  for (t = 0; t < task_num; t++) {
+    if (me == tasks[t]) {
+      return t;
+    }
+  }
+
+  return LOCKSTAT_MAX_TASKS - 1;
+}
+
+int ls_sem_wait(SEM * sem, LOCKSTAT * ls)
+{
+  LOCKSTAT_COUNTS * c;
+  RTIME start, now, wait;
+  int contended;
+  int retval;
+
+  contended = ls->held;
+  start = rt_get_cpu_time_ns();
+  retval = rt_sem_wait(sem);
+  now = rt_get_cpu_time_ns();
+
+  c = &ls->counts[rtai_cpuid()].task[task_slot()];
+  c->acquisitions++;
+  if (contended) {
+    c->contentions++;
+  }
+  wait = now - start;
+  c->wait_total_ns += wait;
+  if (wait > c->wait_max_ns) {
+    c->wait_max_ns = wait;
+  }
+
+  ls->holder = c;
+  ls->taken_ns = now;
+  ls->held = 1;
+
+  return retval;
+}
+
+int ls_sem_signal(SEM * sem, LOCKSTAT * ls)
+{
+  LOCKSTAT_COUNTS * c;
+  RTIME hold;
+
+  ls->counts[rtai_cpuid()].task[task_slot()].releases++;
+
+  c = ls->holder;
+  if (0 != c) {
+    hold = rt_get_cpu_time_ns() - ls->taken_ns;
+    c->hold_total_ns += hold;
+    if (hold > c->hold_max_ns) {
+      c->hold_max_ns = hold;
+    }
+    ls->holder = 0;
+  }
+  ls->held = 0;
+
+  return rt_sem_signal(sem);
+}
+
+int ls_event_wait(SEM * sem, LOCKSTAT * ls)
+{
+  LOCKSTAT_COUNTS * c;
+  RTIME start, wait;
+  int contended;
+  int retval;
+
+  /*
+    If there's a signal waiting, take it without blocking, else wait
+    for one and count that as contention. rt_sem_wait_if() returns
+    the count it found, 0 or less if there was nothing to take.
+   */
+  contended = 0;
+  start = rt_get_cpu_time_ns();
+  retval = rt_sem_wait_if(sem);
+  if (retval <= 0) {
+    contended = 1;
+    retval = rt_sem_wait(sem);
+  }
+  wait = rt_get_cpu_time_ns() - start;
+
+  c = &ls->counts[rtai_cpuid()].task[task_slot()];
+  c->acquisitions++;
+  if (contended) {
+    c->contentions++;
+  }
+  c->wait_total_ns += wait;
+  if (wait > c->wait_max_ns) {
+    c->wait_max_ns = wait;
+  }
+
+  return retval;
+}
+
+int ls_event_signal(SEM * sem, LOCKSTAT * ls)
+{
+  ls->counts[rtai_cpuid()].task[task_slot()].releases++;
+
+  return rt_sem_signal(sem);
+}
+
+/*
+  The /proc read function, which prints one line for each lock, CPU
+  and task that has taken the lock at least once. Times are in
+  nanoseconds. Averages are left to the reader, since 64-bit division
+  isn't available in all kernels.
+ */
+static int lockstat_read_proc(char * page, char ** start, off_t off,
+			      int count, int * eof, void * data)
+{
+  LOCKSTAT_COUNTS * c;
+  char * p = page;
+  int l, cpu, t;
+
+  p += sprintf(p, "%-12s %3s %-12s %10s %10s %10s %14s %12s %14s %12s\n",
+	       "lock", "cpu", "task", "acquired", "contended", "given",
+	       "wait-total", "wait-max", "hold-total", "hold-max");
+
+  for (l = 0; l < LOCKSTAT_MAX_LOCKS; l++) {
+    if (0 == locks[l]) {
+      continue;
+    }
+    for (cpu = 0; cpu < LOCKSTAT_CPUS; cpu++) {
+      for (t = 0; t < LOCKSTAT_MAX_TASKS; t++) {
+	c = &locks[l]->counts[cpu].task[t];
+	if (0 == c->acquisitions && 0 == c->releases) {
+	  continue;
+	}
+	/* stop short of overflowing the page */
+	if (p - page > PAGE_SIZE - 128) {
+	  break;
+	}
+	p += sprintf(p, "%-12s %3d %-12s %10d %10d %10d %14lld %12lld %14lld %12lld\n",
+		     locks[l]->name, cpu,
+		     t < task_num ? task_names[t] : "(other)",
+		     c->acquisitions, c->contentions, c->releases,
+		     c->wait_total_ns, c->wait_max_ns,
+		     c->hold_total_ns, c->hold_max_ns);
+      }
+    }
+  }
+
+  *eof = 1;
+
+  return p - page;
+}
+
+int lockstat_proc_create(void)
+{
+  if (0 == create_proc_read_entry(LOCKSTAT_PROC_NAME, 0, 0,
+				  lockstat_read_proc, 0)) {
+    return -ENOMEM;
+  }
+  proc_created = 1;
+
+  return 0;
+}
+
+void lockstat_proc_remove(void)
+{
+  if (proc_created) {
+    remove_proc_entry(LOCKSTAT_PROC_NAME, 0);
+    proc_created = 0;
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+/*
+  lockstat.h
+
+  Declarations for lock statistics on RTAI semaphores. Use
+  ls_sem_wait() and ls_sem_signal() in place of rt_sem_wait() and
+  rt_sem_signal() on semaphores used as locks, and the wait time,
+  hold time and contention of each lock will be kept for each task
+  and CPU, and shown in /proc/rtai_lockstat. Semaphores that one task
+  signals to wake up another, rather than locks, have no holder, so
+  use ls_event_wait() and ls_event_signal() on them instead, which
+  keep the same counts except for the hold times.
+ */
+
+#include <linux/cache.h>	/* ____cacheline_aligned */
+#include "rtai.h"
+#include "rtai_sched.h"		/* RT_TASK, RTIME */
+#include "rtai_sem.h"		/* SEM */
+
+/*
+  Counts are kept separately for each CPU, each CPU's in a row of its
+  own cache lines, so that tasks on different CPUs don't fight over
+  the same cache lines to count, and for each registered task. Tasks
+  that aren't registered are lumped together in the last slot. Who
+  holds the lock and since when is shared, like the semaphore itself,
+  but is only written by the holder.
+ */
+#ifdef NR_RT_CPUS
+#define LOCKSTAT_CPUS NR_RT_CPUS
+#else
+#define LOCKSTAT_CPUS 1
+#endif
+
+enum {LOCKSTAT_MAX_TASKS = 12};
+enum {LOCKSTAT_MAX_LOCKS = 8};
+
+typedef struct {
+  int acquisitions;		/* how many times the lock was taken */
+  int contentions;		/* how many of these found it already held */
+  int releases;			/* how many times it was given */
+  RTIME wait_total_ns;		/* total time spent waiting to take it */
+  RTIME wait_max_ns;		/* longest wait */
+  RTIME hold_total_ns;		/* total time it was held */
+  RTIME hold_max_ns;		/* longest hold */
+} LOCKSTAT_COUNTS;
+
+typedef struct {
+  LOCKSTAT_COUNTS task[LOCKSTAT_MAX_TASKS];
+} ____cacheline_aligned LOCKSTAT_CPU;
+
+typedef struct {
+  const char * name;		/* shown in /proc */
+  volatile int held;		/* non-zero while someone holds it */
+  RTIME taken_ns;		/* when the holder took it */
+  LOCKSTAT_COUNTS * holder;	/* where the holder's counts go */
+  LOCKSTAT_CPU counts[LOCKSTAT_CPUS]; /* each CPU's counts, by task */
+} LOCKSTAT;
+
+/*
+  lockstat_init() clears the statistics for a lock and registers it for
+  display, returning 0 if OK or -ENOSPC if there are too many locks.
+  lockstat_delete() unregisters it.
+ */
+extern int lockstat_init(LOCKSTAT * ls, const char * name);
+extern void lockstat_delete(LOCKSTAT * ls);
+
+/*
+  lockstat_task_register() gives a task a name and its own counts,
+  returning 0 if OK or -ENOSPC if there are too many tasks.
+ */
+extern int lockstat_task_register(RT_TASK * task, const char * name);
+
+/*
+  ls_sem_wait() and ls_sem_signal() take and give 'sem', counting the
+  statistics into 'ls'. They return what rt_sem_wait() and
+  rt_sem_signal() return.
+ */
+extern int ls_sem_wait(SEM * sem, LOCKSTAT * ls);
+extern int ls_sem_signal(SEM * sem, LOCKSTAT * ls);
+
+/*
+  ls_event_wait() and ls_event_signal() do the same for semaphores
+  that aren't locks. Contention there means the waiter had to block.
+ */
+extern int ls_event_wait(SEM * sem, LOCKSTAT * ls);
+extern int ls_event_signal(SEM * sem, LOCKSTAT * ls);
+
+/*
+  lockstat_proc_create() makes /proc/rtai_lockstat, and
+  lockstat_proc_remove() removes it, if it was made.
+ */
+extern int lockstat_proc_create(void);
+extern void lockstat_proc_remove(void);
+
+#endif /* LOCKSTAT_H */
@@ -0,0 +1,116 @@
+/*
+  rwlock.c
+
+  A reader-writer lock with writer preference, built from RTAI
+  semaphores.
+
+  The counts of readers and writers are protected by a 'guard'
+  semaphore that is held only while the counts are looked at and
+  changed, a handful of instructions, so the cost to a reader that
+  doesn't have to wait is two short takes and gives of the guard. The
+  guard is a resource semaphore, so a low-priority task holding it
+  can't be kept from giving it back by a medium-priority one.
+
+  Tasks that must wait block on 'read_go' or 'write_go', counting
+  semaphores that start at 0. The task giving up the lock hands it
+  directly to the waiters, updating the counts on their behalf before
+  signaling them, so a woken task already owns the lock and doesn't
+  need to check again.
+
+  The guard is taken and given through ls_sem_wait() and
+  ls_sem_signal(), and 'read_go' and 'write_go', which aren't locks,
+  through ls_event_wait() and ls_event_signal(), so all of them are
+  counted in the lock statistics.
+*/
+
+#include "rtai.h"
+#include "rtai_sem.h"		/* SEM, rt_typed_sem_init() */
+#include "rtai_sched.h"		/* sem stuff for RTAI < 3 */
+#include "lockstat.h"		/* ls_sem_wait(), ls_event_wait() */
+#include "rwlock.h"
+
+void rwl_init(RW_LOCK * rwl)
+{
+  rt_typed_sem_init(&rwl->guard, 1, RES_SEM);
+  rt_typed_sem_init(&rwl->read_go, 0, CNT_SEM);
+  rt_typed_sem_init(&rwl->write_go, 0, CNT_SEM);
+  rwl->readers = 0;
+  rwl->readers_waiting = 0;
+  rwl->writer = 0;
+  rwl->writers_waiting = 0;
+  lockstat_init(&rwl->guard_stat, "rw guard");
+  lockstat_init(&rwl->read_stat, "rw read_go");
+  lockstat_init(&rwl->write_stat, "rw write_go");
+}
+
+void rwl_delete(RW_LOCK * rwl)
+{
+  lockstat_delete(&rwl->write_stat);
+  lockstat_delete(&rwl->read_stat);
+  lockstat_delete(&rwl->guard_stat);
+  rt_sem_delete(&rwl->write_go);
+  rt_sem_delete(&rwl->read_go);
+  rt_sem_delete(&rwl->guard);
+}
+
+void rwl_read_take(RW_LOCK * rwl)
+{
+  ls_sem_wait(&rwl->guard, &rwl->guard_stat);
+  if (rwl->writer || rwl->writers_waiting > 0) {
+    /* a writer has it or wants it, so wait our turn */
+    rwl->readers_waiting++;
+    ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+    ls_event_wait(&rwl->read_go, &rwl->read_stat);
+    /* the writer counted us in as a reader before waking us */
+    return;
+  }
+  rwl->readers++;
+  ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+}
+
+void rwl_read_give(RW_LOCK * rwl)
+{
+  ls_sem_wait(&rwl->guard, &rwl->guard_stat);
+  rwl->readers--;
+  if (0 == rwl->readers && rwl->writers_waiting > 0) {
+    /* we were the last reader, so hand off to a writer */
+    rwl->writers_waiting--;
+    rwl->writer = 1;
+    ls_event_signal(&rwl->write_go, &rwl->write_stat);
+  }
+  ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+}
+
+void rwl_write_take(RW_LOCK * rwl)
+{
+  ls_sem_wait(&rwl->guard, &rwl->guard_stat);
+  if (rwl->writer || rwl->readers > 0) {
+    rwl->writers_waiting++;
+    ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+    ls_event_wait(&rwl->write_go, &rwl->write_stat);
+    /* whoever woke us set 'writer' for us */
+    return;
+  }
+  rwl->writer = 1;
+  ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+}
+
+void rwl_write_give(RW_LOCK * rwl)
+{
+  ls_sem_wait(&rwl->guard, &rwl->guard_stat);
+  rwl->writer = 0;
+  if (rwl->writers_waiting > 0) {
+    /* writers first */
+    rwl->writers_waiting--;
+    rwl->writer = 1;
+    ls_event_signal(&rwl->write_go, &rwl->write_stat);
+  } else {
+    /* let in all the readers that piled up */
+    while (rwl->readers_waiting > 0) {
+      rwl->readers_waiting--;
+      rwl->readers++;
+      ls_event_signal(&rwl->read_go, &rwl->read_stat);
+    }
+  }
+  ls_sem_signal(&rwl->guard, &rwl->guard_stat);
+}
@@ -0,0 +1,42 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+/*
+  rwlock.h
+
+  Declarations for a reader-writer lock built from RTAI semaphores.
+  Any number of readers can hold the lock at once, or one writer.
+  Writers are preferred: once a writer is waiting, new readers wait
+  behind it, so a steady stream of readers can't shut out the writer.
+
+  Every take and give of the semaphores inside goes through the lock
+  statistics in lockstat.c, so they show up in /proc/rtai_lockstat as
+  "rw guard", "rw read_go" and "rw write_go".
+ */
+
+#include "rtai_sem.h"		/* SEM */
+#include "lockstat.h"		/* LOCKSTAT */
+
+typedef struct {
+  SEM guard;			/* protects the counts below, briefly */
+  SEM read_go;			/* waiting readers block here */
+  SEM write_go;			/* waiting writers block here */
+  int readers;			/* how many readers hold the lock */
+  int readers_waiting;		/* how many readers are blocked */
+  int writer;			/* non-zero if a writer holds the lock */
+  int writers_waiting;		/* how many writers are blocked */
+  LOCKSTAT guard_stat;		/* statistics for the semaphores above */
+  LOCKSTAT read_stat;
+  LOCKSTAT write_stat;
+} RW_LOCK;
+
+extern void rwl_init(RW_LOCK * rwl);
+extern void rwl_delete(RW_LOCK * rwl);
+
+extern void rwl_read_take(RW_LOCK * rwl);
+extern void rwl_read_give(RW_LOCK * rwl);
+
+extern void rwl_write_take(RW_LOCK * rwl);
+extern void rwl_write_give(RW_LOCK * rwl);
+
+#endif /* RWLOCK_H */
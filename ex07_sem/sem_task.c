@@ -4,6 +4,41 @@
   Set up two periodic tasks that share a large array, and use a semaphore
   to ensure that there are no simultaneous access by the low-priority
   writer and the high-priority reader.
+
+  Optionally, a third task of medium priority can be run that hogs the
+  CPU. This shows "priority inversion": the high-priority reader waits
+  for the low-priority writer to give back the semaphore, but the
+  writer can't run because the medium-priority hog is running, so the
+  reader effectively waits on the hog, which has nothing to do with
+  the shared array. Different kinds of locks can be selected to see
+  how they fix this, and the reader's worst-case wait is measured for
+  each.
+
+  The writer can also double-buffer the array, filling a back copy
+  outside the lock and holding the lock only to swap it to the front.
+  This bounds the reader's wait by the swap, rather than by the time
+  to fill the whole array.
+
+  Several readers can be run at different rates, and they can share a
+  reader-writer lock (see rwlock.c) instead of the semaphore, so that
+  they don't have to wait for each other, only for the writer.
+
+  Takes and gives of the semaphore, and of all the others, inside the
+  reader-writer lock and for the parallel fill, are done through the
+  lock statistics wrappers in lockstat.c, so while the example runs
+  you can see the wait and hold times and contention for each task
+  with
+
+  cat /proc/rtai_lockstat
+
+  Each task also keeps count of its overruns, the cycles that run
+  past the start of its next period, through admit.c. Before a task is
+  made periodic we check that the tasks on its CPU can all fit, and
+  the writer's overruns are handled according to OVERRUN_POLICY.
+
+  On multiprocessors the writer can split filling the array among
+  FILL_WORKERS tasks, one per CPU, waiting for them all to finish
+  before publishing the new contents.
 */
 
 #include <linux/kernel.h>
@@ -12,9 +47,13 @@
 #include <linux/sched.h>
 #include <linux/errno.h>	/* ENOMEM */
 #include <linux/moduleparam.h>
+#include <linux/cpumask.h>	/* num_online_cpus() */
 #include "rtai.h"
 #include "rtai_sem.h"		/* SEM, rt_sem_init() */
 #include "rtai_sched.h"		/* sched stuff plus sem stuff for RTAI < 3 */
+#include "rwlock.h"		/* RW_LOCK, rwl_init() */
+#include "lockstat.h"		/* LOCKSTAT, ls_sem_wait(), ls_sem_signal() */
+#include "admit.h"		/* ADMIT_TASK, admit_make_periodic() */
 
 /*
   Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
@@ -39,28 +78,134 @@
 MODULE_LICENSE("GPL");
 #endif
 
-RT_TASK fast_task;
+/*
+  We can have up to MAX_READERS fast reader tasks. Reader 'i' runs
+  every 'i + 1' base periods.
+ */
+enum {MAX_READERS = 4};
+
+RT_TASK fast_task[MAX_READERS];
+RT_TASK hog_task;
 RT_TASK slow_task;
 
+/*
+  The writer can have up to MAX_WORKERS - 1 helpers for filling the
+  array, worker 'w' on CPU TASK_CPU + w. The writer itself is worker 0.
+ */
+enum {MAX_WORKERS = 4};
+
+RT_TASK fill_task[MAX_WORKERS];
+
+/*
+  Priorities of the tasks. The faster the reader, the higher its
+  priority, with reader 0 the highest of all. The hog is in between the
+  readers and the slow writer.
+ */
+#define FAST_PRIORITY(i) (RT_LOWEST_PRIORITY - 1 - MAX_READERS + (i))
+#define HOG_PRIORITY (RT_LOWEST_PRIORITY - 1)
+#define SLOW_PRIORITY RT_LOWEST_PRIORITY
+
+/*
+  Priority inversion only happens when the tasks compete for the same
+  CPU, so on multiprocessors we put them all on this one, unless the
+  readers are spread out; see READER_CPUS below.
+ */
+#define TASK_CPU 0
+
 static RTIME period_ns = 100000; /* 100 microsecond base period */
 
-static RTIME fast_period_count;
+static RTIME fast_period_count[MAX_READERS];
+static RTIME hog_period_count;
 static RTIME slow_period_count;
 
 /*
   SEM is the RTAI semaphore structure. We'll use one for the shared
-  data structure.
+  data structure, or else the reader-writer lock.
  */
 static SEM sem;
+static RW_LOCK rwl;
+static LOCKSTAT sem_stat;	/* statistics for 'sem' */
+
+/*
+  Overrun accounting and admission control for each task. The readers
+  and the hog just count their overruns and catch up, as RTAI would
+  do anyway; the writer does what OVERRUN_POLICY says.
+ */
+static ADMIT_TASK fast_admit[MAX_READERS];
+static ADMIT_TASK hog_admit;
+static ADMIT_TASK slow_admit;
+
+/*
+  Execution time budgets, in nanoseconds, used for admission. These
+  are guesses; with DEGRADE_OVERRUN, admit.c raises the writer's if
+  it's seen to take longer.
+ */
+enum {READER_BUDGET_NS = 20000};
 
 enum {SLOW_DELAY = 10};
 
-static int read_count = 0;
+/*
+  The hog runs every HOG_DELAY base periods, and each time busy-waits
+  for HOG_BUSY_NS nanoseconds, using most of the CPU.
+ */
+enum {HOG_DELAY = 20};
+enum {HOG_BUSY_NS = 1500000};
+
+/*
+  Each reader keeps its own counts, since readers on different CPUs
+  could otherwise both increment the same count at once and lose one.
+ */
+static int read_count[MAX_READERS] = {0};
+static int bad_count[MAX_READERS] = {0};
 static int write_count = 0;
-static int bad_count = 0;
+static int hog_count = 0;
+
+/*
+  Each reader's longest wait for the lock, in nanoseconds, and how many
+  times it had to wait longer than a base period. The worst case is
+  what matters for meeting deadlines.
+ */
+static RTIME wait_max_ns[MAX_READERS] = {0};
+static int wait_long_count[MAX_READERS] = {0};
+
+/*
+  Rather than just the two ends, the readers look at READ_SAMPLES
+  elements spread across the array, so that reading takes long enough
+  that readers could get in each other's way.
+ */
+enum {READ_SAMPLES = 100};
 
+/*
+  The shared array is reached through the 'array' pointer. Normally
+  this always points to 'array_a', and the writer writes it in place.
+  When double-buffering, the writer fills whichever one 'array'
+  doesn't point to, then swaps the pointer.
+ */
 enum {ARRAY_SIZE = 1000000};
-static int array[ARRAY_SIZE] = {0};
+static int array_a[ARRAY_SIZE] = {0};
+static int array_b[ARRAY_SIZE] = {0};
+static int * array = array_a;
+
+/*
+  The parallel fill. The writer sets 'fill_dest' and 'fill_value',
+  signals each helper's 'fill_go' semaphore, fills its own slice, then
+  waits on 'fill_done' once per helper. This is the barrier: when the
+  writer gets past it, every slice has been written, and the array can
+  be published.
+ */
+static SEM fill_go[MAX_WORKERS];
+static SEM fill_done;
+static LOCKSTAT fill_go_stat;	/* statistics for all the 'fill_go's */
+static LOCKSTAT fill_done_stat;
+static int * fill_dest;
+static int fill_value;
+
+/*
+  How long each fill takes, from start to the last worker finishing,
+  in nanoseconds. The total is in microseconds, to fit in a long.
+ */
+static RTIME fill_max_ns = 0;
+static long fill_total_us = 0;
 
 /*
   The DO_SEM flag tells us whether to use semaphores or not. Presumably
@@ -71,129 +216,540 @@ static int array[ARRAY_SIZE] = {0};
 int DO_SEM = 0;
 module_param(DO_SEM, int, 0);
 
-static void fast_function(int arg)
+/*
+  LOCK_TYPE selects which kind of lock is used when DO_SEM is set.
+
+  BINARY_LOCK is a plain binary semaphore. Nothing stops the hog from
+  preempting the writer while it holds the semaphore, so the reader's
+  wait is as long as the hog wants it to be.
+
+  INHERIT_LOCK is an RTAI resource semaphore, which does "priority
+  inheritance": while the reader waits, the writer holding the
+  semaphore runs at the reader's priority, so the hog can't preempt it.
+
+  CEILING_LOCK is a binary semaphore whose takers first raise their
+  priority to the highest of any task that takes it, the "priority
+  ceiling", and drop back down after giving it. The hog can't preempt
+  the writer here either, and the writer doesn't even have to wait
+  for the reader to block before this happens.
+
+  RW_LOCK_TYPE is the reader-writer lock. Readers only wait for the
+  writer, not for each other, and once the writer is waiting no new
+  readers get in ahead of it.
+
+  DO_HOG tells us whether to run the medium-priority hog task.
+ */
+enum {BINARY_LOCK = 1, INHERIT_LOCK = 2, CEILING_LOCK = 3, RW_LOCK_TYPE = 4};
+
+int LOCK_TYPE = BINARY_LOCK;
+module_param(LOCK_TYPE, int, 0);
+
+int DO_HOG = 0;
+module_param(DO_HOG, int, 0);
+
+/*
+  WRITE_MODE selects how the writer updates the array.
+
+  IN_PLACE_WRITE fills the array while holding the lock, so the reader
+  may wait as long as it takes to write all ARRAY_SIZE ints.
+
+  DOUBLE_WRITE fills the back copy without the lock, since nobody
+  else looks at it, then takes the lock just long enough to swap the
+  back copy to the front. The new contents appear all at once.
+ */
+enum {IN_PLACE_WRITE = 1, DOUBLE_WRITE = 2};
+
+int WRITE_MODE = IN_PLACE_WRITE;
+module_param(WRITE_MODE, int, 0);
+
+/*
+  NUM_READERS is how many fast reader tasks to run, 1..MAX_READERS.
+  READER_CPUS is how many CPUs to spread them across, starting with
+  TASK_CPU. Readers can only really read at the same time if they're
+  on different CPUs.
+ */
+int NUM_READERS = 1;
+module_param(NUM_READERS, int, 0);
+
+int READER_CPUS = 1;
+module_param(READER_CPUS, int, 0);
+
+/*
+  OVERRUN_POLICY says what the writer does when filling the array
+  takes longer than its period: SKIP_OVERRUN, CATCH_UP_OVERRUN or
+  DEGRADE_OVERRUN, as in admit.h. The default, CATCH_UP_OVERRUN, is
+  what RTAI does anyway, so the writer runs at the same rate as it
+  always has. With the hog, DEGRADE_OVERRUN will slow the writer
+  down, since the hog's time counts against the writer's cycles.
+  WRITER_BUDGET_NS is how long we expect the fill to take, in
+  nanoseconds.
+ */
+int OVERRUN_POLICY = CATCH_UP_OVERRUN;
+module_param(OVERRUN_POLICY, int, 0);
+
+int WRITER_BUDGET_NS = 500000;
+module_param(WRITER_BUDGET_NS, int, 0);
+
+/*
+  FILL_WORKERS is how many CPUs fill the array, 1..MAX_WORKERS. With 1,
+  the writer does it all itself as usual.
+ */
+int FILL_WORKERS = 1;
+module_param(FILL_WORKERS, int, 0);
+
+#define CEILING_PRIORITY FAST_PRIORITY(0)
+
+/*
+  lock_take() and lock_give() bracket the writer's critical sections,
+  and read_lock_take() and read_lock_give() the readers', doing what's
+  needed for the selected LOCK_TYPE. 'priority' is the priority of the
+  calling task, which we return to after giving the lock when using a
+  priority ceiling. Only the reader-writer lock treats readers any
+  differently than writers.
+ */
+static void lock_take(int priority)
+{
+  if (RW_LOCK_TYPE == LOCK_TYPE) {
+    rwl_write_take(&rwl);
+    return;
+  }
+  if (CEILING_LOCK == LOCK_TYPE && priority != CEILING_PRIORITY) {
+    rt_change_prio(rt_whoami(), CEILING_PRIORITY);
+  }
+  ls_sem_wait(&sem, &sem_stat);
+}
+
+static void lock_give(int priority)
+{
+  if (RW_LOCK_TYPE == LOCK_TYPE) {
+    rwl_write_give(&rwl);
+    return;
+  }
+  ls_sem_signal(&sem, &sem_stat);
+  if (CEILING_LOCK == LOCK_TYPE && priority != CEILING_PRIORITY) {
+    rt_change_prio(rt_whoami(), priority);
+  }
+}
+
+static void read_lock_take(int priority)
+{
+  if (RW_LOCK_TYPE == LOCK_TYPE) {
+    rwl_read_take(&rwl);
+  } else {
+    lock_take(priority);
+  }
+}
+
+static void read_lock_give(int priority)
 {
+  if (RW_LOCK_TYPE == LOCK_TYPE) {
+    rwl_read_give(&rwl);
+  } else {
+    lock_give(priority);
+  }
+}
+
+/*
+  fast_function() is the code for all the readers. 'which' is the
+  reader number, 0..NUM_READERS-1.
+ */
+static void fast_function(int which)
+{
+  RTIME start, wait;
+  int * front;
+  int t;
+
   while (1) {
+    admit_cycle_start(&fast_admit[which]);
     /*
       Bracket "critical section" reading of shared data structure
-      with semaphore take/give.
+      with semaphore take/give, and see how long we waited.
     */
     if (DO_SEM) {
-      rt_sem_wait(&sem);
+      start = rt_get_cpu_time_ns();
+      read_lock_take(FAST_PRIORITY(which));
+      wait = rt_get_cpu_time_ns() - start;
+      if (wait > period_ns) {
+	wait_long_count[which]++;
+      }
+      if (wait > wait_max_ns[which]) {
+	wait_max_ns[which] = wait;
+      }
+    }
+    /*
+      Look at the pointer just once, in case the writer swaps it.
+     */
+    front = array;
+    for (t = ARRAY_SIZE / READ_SAMPLES; t < ARRAY_SIZE;
+	 t += ARRAY_SIZE / READ_SAMPLES) {
+      if (front[0] != front[t]) {
+	break;
+      }
     }
-    if (array[0] != array[ARRAY_SIZE - 1]) {
-      bad_count++;
+    if (t < ARRAY_SIZE || front[0] != front[ARRAY_SIZE - 1]) {
+      bad_count[which]++;
     }
     if (DO_SEM) {
-      rt_sem_signal(&sem);
+      read_lock_give(FAST_PRIORITY(which));
     }
 
-    read_count++;
+    read_count[which]++;
 
+    admit_cycle_end(&fast_admit[which]);
     rt_task_wait_period();
   }
 
   return;
 }
 
+/*
+  fill_slice() fills worker 'w's share of 'fill_dest' with
+  'fill_value'. The last worker picks up any remainder.
+ */
+static void fill_slice(int w)
+{
+  int slice = ARRAY_SIZE / FILL_WORKERS;
+  int end = (w == FILL_WORKERS - 1 ? ARRAY_SIZE : (w + 1) * slice);
+  int t;
+
+  for (t = w * slice; t < end; t++) {
+    fill_dest[t] = fill_value;
+  }
+}
+
+/*
+  fill_function() is the code for the helpers, worker 1 and up. Each
+  one waits to be told to go, fills its slice and says it's done.
+ */
+static void fill_function(int w)
+{
+  while (1) {
+    ls_event_wait(&fill_go[w], &fill_go_stat);
+    fill_slice(w);
+    ls_event_signal(&fill_done, &fill_done_stat);
+  }
+
+  return;
+}
+
+/*
+  fill_array() sets all of 'dest' to 'value', using all the workers,
+  and returns when they're all done.
+ */
+static void fill_array(int * dest, int value)
+{
+  RTIME start, fill;
+  int w;
+
+  start = rt_get_cpu_time_ns();
+
+  fill_dest = dest;
+  fill_value = value;
+  for (w = 1; w < FILL_WORKERS; w++) {
+    ls_event_signal(&fill_go[w], &fill_go_stat);
+  }
+  fill_slice(0);
+  for (w = 1; w < FILL_WORKERS; w++) {
+    ls_event_wait(&fill_done, &fill_done_stat);
+  }
+
+  fill = rt_get_cpu_time_ns() - start;
+  if (fill > fill_max_ns) {
+    fill_max_ns = fill;
+  }
+  fill_total_us += (long) fill / 1000;
+}
+
 static void slow_function(int arg)
 {
-  RTIME start, end, diff;
   int count = 0;		/* what we fill the array with */
-  int t;
+  int * back;			/* the array not being read */
 
   while (1) {
-    /*
-      Bracket critical section writing of shared data structure
-      with semaphore take/give.
-     */
+    admit_cycle_start(&slow_admit);
     count++;
-    if (DO_SEM) {
-      rt_sem_wait(&sem);
-    }
-    start = rt_get_time();
-    for (t = 0; t <  ARRAY_SIZE; t++) {
-      array[t] = count;
-    }
-    end = rt_get_time();
-    if (DO_SEM) {
-      rt_sem_signal(&sem);
+    if (DOUBLE_WRITE == WRITE_MODE) {
+      /*
+	Fill the back copy, which the reader never looks at, so we
+	don't need the lock. Then swap it to the front, with the lock
+	held for just the swap.
+       */
+      back = (array == array_a ? array_b : array_a);
+      fill_array(back, count);
+      if (DO_SEM) {
+	lock_take(SLOW_PRIORITY);
+      }
+      array = back;
+      if (DO_SEM) {
+	lock_give(SLOW_PRIORITY);
+      }
+    } else {
+      /*
+	Bracket critical section writing of shared data structure
+	with semaphore take/give. With FILL_WORKERS, we hold the lock
+	while the helpers fill their slices too, and readers wait for
+	all of it. That's what writing in place means: the readers
+	can't look until the whole array is written. The helpers just
+	make that wait shorter. To keep readers from waiting on the
+	fill at all, use DOUBLE_WRITE.
+      */
+      if (DO_SEM) {
+	lock_take(SLOW_PRIORITY);
+      }
+      fill_array(array, count);
+      if (DO_SEM) {
+	lock_give(SLOW_PRIORITY);
+      }
     }
 
+    write_count++;
+
     /*
-      Check the time it takes to set the array, and if it takes longer
-      than our period, make us run slower. Otherwise this task locks
+      If setting the array took longer than our period, this handles
+      it according to OVERRUN_POLICY. Otherwise this task could lock
       up the CPU.
      */
-    if (end > start) {
-      diff = end - start;
-    } else {
-      diff = slow_period_count;
-    }
-    if (diff > slow_period_count) {
-      slow_period_count += diff;
-      rt_task_make_periodic(rt_whoami(), end + slow_period_count,
-			    slow_period_count);
-    }
+    admit_cycle_end(&slow_admit);
+    rt_task_wait_period();
+  }
 
-    write_count++;
+  return;
+}
 
+/*
+  hog_function() has nothing to do with the shared array. It just
+  burns CPU time at a priority between the readers and the writer.
+ */
+static void hog_function(int arg)
+{
+  while (1) {
+    admit_cycle_start(&hog_admit);
+    rt_busy_sleep(HOG_BUSY_NS);
+    hog_count++;
+    admit_cycle_end(&hog_admit);
     rt_task_wait_period();
   }
 
   return;
 }
 
+/*
+  start_periodic() makes the task periodic through admission control.
+  If the CPU can't fit it at 'period', we keep doubling the period
+  until it does, rather than not running it at all. Returns the
+  period we ended up with, or 0 if it couldn't be admitted.
+ */
+enum {MAX_DOUBLINGS = 10};
+
+static RTIME start_periodic(ADMIT_TASK * at, RTIME period)
+{
+  int t;
+
+  for (t = 0; t <= MAX_DOUBLINGS; t++) {
+    if (0 == admit_make_periodic(at, rt_get_time() + period, period)) {
+      if (t > 0) {
+	printk("%s slowed down %d times to be admitted\n", at->name, t);
+      }
+      return period;
+    }
+    period *= 2;
+  }
+
+  printk("%s can't be admitted, not running\n", at->name);
+  return 0;
+}
+
 int init_module(void)
 {
-  fast_period_count = nano2count(period_ns);
-  slow_period_count = SLOW_DELAY * fast_period_count;
+  static char * reader_names[MAX_READERS] = {
+    "reader 0", "reader 1", "reader 2", "reader 3"
+  };
+  static char * helper_names[MAX_WORKERS] = {
+    "writer", "helper 1", "helper 2", "helper 3"
+  };
+  RTIME base_period_count;
+  int cpus;
+  int t;
+
+  if (NUM_READERS < 1) NUM_READERS = 1;
+  else if (NUM_READERS > MAX_READERS) NUM_READERS = MAX_READERS;
+  if (READER_CPUS < 1) READER_CPUS = 1;
+  if (FILL_WORKERS < 1) FILL_WORKERS = 1;
+  else if (FILL_WORKERS > MAX_WORKERS) FILL_WORKERS = MAX_WORKERS;
+
+  /*
+    Readers and fill workers are put on CPUs from TASK_CPU up, so
+    there have to be that many. A task on a CPU that isn't there never
+    runs, and a fill worker that never runs leaves the writer waiting
+    for it forever.
+   */
+  cpus = num_online_cpus() - TASK_CPU;
+  if (cpus < 1) cpus = 1;
+  if (READER_CPUS > cpus) {
+    printk("only %d CPUs, so READER_CPUS is %d, not %d\n",
+	   cpus, cpus, READER_CPUS);
+    READER_CPUS = cpus;
+  }
+  if (FILL_WORKERS > cpus) {
+    printk("only %d CPUs, so FILL_WORKERS is %d, not %d\n",
+	   cpus, cpus, FILL_WORKERS);
+    FILL_WORKERS = cpus;
+  }
+
+  base_period_count = nano2count(period_ns);
+  for (t = 0; t < NUM_READERS; t++) {
+    fast_period_count[t] = (t + 1) * base_period_count;
+  }
+  hog_period_count = HOG_DELAY * base_period_count;
+  slow_period_count = SLOW_DELAY * base_period_count;
   rt_set_periodic_mode();
-  start_rt_timer(fast_period_count);
+  start_rt_timer(base_period_count);
 
   /*
     Set up the semaphore by calling
 
-    void rt_sem_init(SEM * sem, int value);
+    void rt_typed_sem_init(SEM * sem, int value, int type);
 
     where 'value' is 1 so that the first call to rt_sem_wait()
     by the other tasks will return, allowing the first access.
+    'type' is BIN_SEM for a binary semaphore, or RES_SEM for a
+    resource semaphore, which is a binary semaphore that does
+    priority inheritance.
    */
-  rt_sem_init(&sem, 1);	/* FIXME */
+  if (INHERIT_LOCK == LOCK_TYPE) {
+    rt_typed_sem_init(&sem, 1, RES_SEM);
+  } else {
+    rt_typed_sem_init(&sem, 1, BIN_SEM);
+  }
+  rwl_init(&rwl);
+  lockstat_init(&sem_stat, "sem");
+  if (0 != lockstat_proc_create()) {
+    printk("can't create lock statistics /proc entry\n");
+  }
+
+  /*
+    Start the fast tasks at the highest of our priorities.
+   */
+  for (t = 0; t < NUM_READERS; t++) {
+    (void) rt_task_init_cpuid(&fast_task[t], fast_function, t, 1024,
+			      FAST_PRIORITY(t), 0, 0,
+			      TASK_CPU + t % READER_CPUS);
+    lockstat_task_register(&fast_task[t], reader_names[t]);
+    (void) admit_task_init(&fast_admit[t], &fast_task[t], reader_names[t],
+			   TASK_CPU + t % READER_CPUS, READER_BUDGET_NS,
+			   CATCH_UP_OVERRUN);
+    fast_period_count[t] = start_periodic(&fast_admit[t],
+					  fast_period_count[t]);
+  }
 
   /*
-    Start the fast task at the next-lowest priority.
+    Start the hog task in the middle, if we want it.
    */
-  (void) rt_task_init(&fast_task, fast_function, 0, 1024,
-		      RT_LOWEST_PRIORITY - 1, 0, 0);
-  rt_task_make_periodic(&fast_task, rt_get_time() + fast_period_count, 
-			fast_period_count);
+  if (DO_HOG) {
+    (void) rt_task_init_cpuid(&hog_task, hog_function, 0, 1024,
+			      HOG_PRIORITY, 0, 0, TASK_CPU);
+    (void) admit_task_init(&hog_admit, &hog_task, "hog", TASK_CPU,
+			   HOG_BUSY_NS, CATCH_UP_OVERRUN);
+    hog_period_count = start_periodic(&hog_admit, hog_period_count);
+  }
+
+  /*
+    Start the fill helpers, if any, each on its own CPU. They wait on
+    their 'fill_go' semaphores, which start out taken, until the
+    writer needs them. They don't compete with the writer, so they
+    run at its priority. They aren't periodic tasks, but run when the
+    writer does, so they aren't put through admission control, and
+    the admission of readers spread onto their CPUs doesn't count them.
+   */
+  rt_typed_sem_init(&fill_done, 0, CNT_SEM);
+  lockstat_init(&fill_go_stat, "fill go");
+  lockstat_init(&fill_done_stat, "fill done");
+  for (t = 1; t < FILL_WORKERS; t++) {
+    rt_typed_sem_init(&fill_go[t], 0, BIN_SEM);
+    (void) rt_task_init_cpuid(&fill_task[t], fill_function, t, 1024,
+			      SLOW_PRIORITY, 0, 0, TASK_CPU + t);
+    lockstat_task_register(&fill_task[t], helper_names[t]);
+    rt_task_resume(&fill_task[t]);
+  }
 
   /*
     Start the slow task at the lowest priority.
   */
-  (void) rt_task_init(&slow_task, slow_function, 0, 1024,
-		      RT_LOWEST_PRIORITY, 0, 0);
-  rt_task_make_periodic(&slow_task, rt_get_time() + slow_period_count,
-			slow_period_count);
+  (void) rt_task_init_cpuid(&slow_task, slow_function, 0, 1024,
+			    SLOW_PRIORITY, 0, 0, TASK_CPU);
+  lockstat_task_register(&slow_task, "writer");
+  (void) admit_task_init(&slow_admit, &slow_task, "writer", TASK_CPU,
+			 WRITER_BUDGET_NS, OVERRUN_POLICY);
+  slow_period_count = start_periodic(&slow_admit, slow_period_count);
 
   return 0;
 }
 
 void cleanup_module(void)
 {
+  static char * lock_names[] = {"?", "binary", "inherit", "ceiling", "rw"};
+  int total_reads, total_bad;
+  int t;
+
   rt_task_delete(&slow_task);
-  rt_task_delete(&fast_task);
+  admit_task_delete(&slow_admit);
+  for (t = 1; t < FILL_WORKERS; t++) {
+    rt_task_delete(&fill_task[t]);
+    rt_sem_delete(&fill_go[t]);
+  }
+  rt_sem_delete(&fill_done);
+  lockstat_delete(&fill_done_stat);
+  lockstat_delete(&fill_go_stat);
+  if (DO_HOG) {
+    rt_task_delete(&hog_task);
+    admit_task_delete(&hog_admit);
+  }
+  for (t = 0; t < NUM_READERS; t++) {
+    rt_task_delete(&fast_task[t]);
+    admit_task_delete(&fast_admit[t]);
+  }
 
+  lockstat_proc_remove();
+  lockstat_delete(&sem_stat);
+  rwl_delete(&rwl);
   rt_sem_delete(&sem);
 
+  total_reads = 0;
+  total_bad = 0;
+  for (t = 0; t < NUM_READERS; t++) {
+    total_reads += read_count[t];
+    total_bad += bad_count[t];
+  }
+
   if (DO_SEM) {
-    printk("with sem: reads/writes/bad reads = %d/%d/%d\n",
-	   read_count, write_count, bad_count);
+    printk("with %s sem%s%s: reads/writes/bad reads = %d/%d/%d\n",
+	   lock_names[LOCK_TYPE >= BINARY_LOCK && LOCK_TYPE <= RW_LOCK_TYPE ?
+		      LOCK_TYPE : 0],
+	   DO_HOG ? " and hog" : "",
+	   DOUBLE_WRITE == WRITE_MODE ? ", double-buffered" : "",
+	   total_reads, write_count, total_bad);
+    for (t = 0; t < NUM_READERS; t++) {
+      printk("reader %d: reads = %d, bad reads = %d, wait max = %d nsecs, "
+	     "%d waits over a period\n", t, read_count[t], bad_count[t],
+	     (int) wait_max_ns[t], wait_long_count[t]);
+    }
+    printk("hog ran %d times\n", hog_count);
   } else {
     printk("no sem: reads/writes/bad counts = %d/%d/%d\n",
-	   read_count, write_count, bad_count);
+	   total_reads, write_count, total_bad);
+  }
+
+  for (t = 0; t < NUM_READERS; t++) {
+    admit_report(&fast_admit[t]);
   }
+  if (DO_HOG) {
+    admit_report(&hog_admit);
+  }
+  admit_report(&slow_admit);
+
+  printk("%d fill workers: fill max = %d usecs, average = %ld usecs\n",
+	 FILL_WORKERS, (int) fill_max_ns / 1000,
+	 write_count > 0 ? fill_total_us / write_count : 0L);
 
   return;
 }
@@ -1,12 +1,39 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#define RC_NUM 3
+#define RC_NUM 3		/* how many motors by default */
+#define RC_MAX 64		/* how many motors at most, 8 per port */
 
 typedef struct {
-  int which;			/* which motor to set, 0..RC_NUM */
+  int which;			/* which motor to set, 0..RC_NUM-1 */
   int position;			/* what position to set, -1000..1000 */
 } COMMAND_STRUCT;
 
+/*
+  Trajectories are sent on a second FIFO, as batches of up to
+  TRAJ_BATCH points for one motor. Each point says where the motor
+  should be 'dt_ms' milliseconds after the point before it. The RT
+  side moves the motor between points, in a straight line or along a
+  smooth cubic curve, a little each 20 millisecond frame.
+ */
+#define TRAJ_FIFO 1
+#define TRAJ_BATCH 16
+#define TRAJ_POINTS 64		/* how many points the RT side buffers */
+#define TRAJ_DT_MAX 10000	/* longest time between points, msecs */
+
+enum {TRAJ_LINEAR = 1, TRAJ_CUBIC = 2};
+
+typedef struct {
+  int dt_ms;			/* time since the previous point */
+  int position;			/* where to be then, -1000..1000 */
+} TRAJ_POINT;
+
+typedef struct {
+  int which;			/* which motor, 0..RC_NUM-1 */
+  int mode;			/* TRAJ_LINEAR or TRAJ_CUBIC */
+  int count;			/* how many points follow, 1..TRAJ_BATCH */
+  TRAJ_POINT point[TRAJ_BATCH];
+} TRAJ_STRUCT;
+
 #endif /* COMMON_H */
 
@@ -1,5 +1,13 @@
 /*
   rcservo_app.c
+
+  With no arguments, reads motor positions typed in and sends them to
+  the RT task one at a time.
+
+  With '-s <motor>', sweeps the motor back and forth by sending it a
+  trajectory, a batch of timed points at a time, which the RT task
+  follows on its own. Add '-c' for cubic rather than straight-line
+  moves between the points.
 */
 
 /*
@@ -10,15 +18,81 @@
 #include <stdio.h>
 #include <unistd.h>		/* open() */
 #include <fcntl.h>		/* O_RDONLY */
+#include <stdlib.h>		/* atoi() */
+#include <string.h>		/* strcmp() */
 #include "common.h"
 
-int main()
+/*
+  The sweep goes from -1000 to 1000 and back in SWEEP_STEPS points,
+  SWEEP_DT_MS apart, SWEEP_TIMES times.
+ */
+enum {SWEEP_STEPS = 8, SWEEP_DT_MS = 250, SWEEP_TIMES = 10};
+
+/*
+  sweep() sends the sweep trajectory for motor 'which'. We send a
+  batch, then sleep for as long as it takes to run, so there's never
+  more than two batches queued in the RT task. This is how a real
+  application would pace itself, rather than sending a new position
+  every frame.
+ */
+static int sweep(int which, int mode)
+{
+  TRAJ_STRUCT batch;
+  int fd;
+  int step, t;
+
+  if ((fd = open("/dev/rtf1", O_WRONLY)) < 0) {
+    fprintf(stderr, "error opening /dev/rtf1\n");
+    return 1;
+  }
+
+  batch.which = which;
+  batch.mode = mode;
+  batch.count = 0;
+  for (step = 0; step < SWEEP_STEPS * SWEEP_TIMES; step++) {
+    /* a triangle wave */
+    t = step % SWEEP_STEPS;
+    if (t > SWEEP_STEPS / 2) t = SWEEP_STEPS - t;
+    batch.point[batch.count].dt_ms = SWEEP_DT_MS;
+    batch.point[batch.count].position = -1000 + t * 4000 / SWEEP_STEPS;
+    batch.count++;
+
+    if (TRAJ_BATCH == batch.count ||
+	step == SWEEP_STEPS * SWEEP_TIMES - 1) {
+      if (sizeof(batch) != write(fd, &batch, sizeof(batch))) {
+	fprintf(stderr, "can't write trajectory\n");
+	close(fd);
+	return 1;
+      }
+      /* the first batch goes ahead, then we keep up with it */
+      if (step >= TRAJ_BATCH) {
+	usleep(batch.count * SWEEP_DT_MS * 1000);
+      }
+      batch.count = 0;
+    }
+  }
+
+  close(fd);
+
+  return 0;
+}
+
+int main(int argc, char * argv[])
 {
   enum {BUFFERLEN = 80};
   char buffer[BUFFERLEN];
   COMMAND_STRUCT command;
   int fd;
   int retval;
+  int t;
+
+  for (t = 1; t < argc; t++) {
+    if (! strcmp(argv[t], "-s") && t + 1 < argc) {
+      return sweep(atoi(argv[t + 1]),
+		   t + 2 < argc && ! strcmp(argv[t + 2], "-c") ?
+		   TRAJ_CUBIC : TRAJ_LINEAR);
+    }
+  }
 
   /* open RT FIFO 0 */
   if ((fd = open("/dev/rtf0", O_WRONLY)) < 0) {
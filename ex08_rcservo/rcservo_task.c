@@ -8,6 +8,24 @@
   At 5 V input, need all of 20K pull-up.
 
   Min time is 0.35 msec, max is 2.45 msec.
+
+  There are two ways of generating the pulses, selected by PWM_MODE.
+  The original way uses one task to start all the pulses and one task
+  per servo to end its pulse. The edge scheduler does it all with one
+  task, which sorts the pulse ends and goes from one to the next. It
+  sleeps only when the next end is more than EDGE_SPIN_NS away, and
+  spins otherwise, so with any number of servos it wakes up at most
+  2 + 2100 usecs / EDGE_SPIN_NS times a frame, since all the pulse
+  ends fall within 2100 usecs of each other.
+
+  Each port drives 8 servos, one per data bit. Servo 'c' is on bit
+  'c % 8' of port RC_PORTS[c / 8]. Servos on ports given as 0 are
+  timed but not written, so the scheduler can be tried with more
+  servos than there are ports.
+
+  Besides single positions on FIFO 0, servos can be sent trajectories
+  on FIFO 1, lists of timed points that are interpolated each frame,
+  so smooth motion doesn't need a stream of commands from Linux.
 */
 
 #include <linux/module.h>
@@ -15,6 +33,8 @@
 #include <linux/version.h>
 #include <linux/sched.h>
 #include <asm/io.h>
+#include "portio.h"		/* PORT_REG, port_update() */
+#include "precise.h"		/* PRECISE, precise_sleep_until() */
 #include "rtai.h"
 #include "rtai_sched.h"
 #include "rtai_fifos.h"
@@ -35,13 +55,259 @@
 #define LPT_PORT 	0x378
 #define LPT_CTRL	((LPT_PORT)+2)
 
-#define RC_NUM 3
 static RT_TASK up_task;
-static RT_TASK down_task[RC_NUM];
-static RTIME up_period[RC_NUM];
+static RT_TASK down_task[RC_MAX];
+static RTIME up_period[RC_MAX];
 #define STACKSIZE 1024
 #define FIFOSIZE 1024
 
+/*
+  RC_CHANNELS is how many servos to run, 1..RC_MAX. RC_PORTS is the
+  list of port addresses, 8 servos each.
+ */
+int RC_CHANNELS = RC_NUM;
+module_param(RC_CHANNELS, int, 0);
+
+enum {RC_PORT_NUM = RC_MAX / 8};
+static int RC_PORTS[RC_PORT_NUM] = {LPT_PORT};
+static int rc_ports_given = 0;
+module_param_array(RC_PORTS, int, &rc_ports_given, 0);
+
+/*
+  PWM_MODE selects how the pulses are made.
+
+  TASK_PER_CHANNEL runs the up task and a down task for each servo.
+
+  EDGE_SCHEDULER runs just the edge task, described below.
+  EDGE_WINDOW_NS is how close together two pulse ends have to be to
+  be done with one port write, in nanoseconds. The later ones end up
+  to this much early.
+
+  EDGE_SPIN_NS is how far away the next pulse end has to be for the
+  edge task to sleep until it; closer than this, it spins on the
+  clock instead. Every sleep is a task switch and a timer interrupt,
+  so this bounds them, at the cost of spinning through the short
+  gaps, which add up to no more than the spread of the pulse ends,
+  2100 usecs a frame at worst. 0 sleeps for every end.
+ */
+enum {TASK_PER_CHANNEL = 1, EDGE_SCHEDULER = 2};
+
+int PWM_MODE = EDGE_SCHEDULER;
+module_param(PWM_MODE, int, 0);
+
+int EDGE_WINDOW_NS = 2000;
+module_param(EDGE_WINDOW_NS, int, 0);
+
+int EDGE_SPIN_NS = 500000;
+module_param(EDGE_SPIN_NS, int, 0);
+
+/*
+  With PRECISE_EDGES set, the edge scheduler wakes up a little before
+  each edge and spins until it's time, so the edges aren't off by the
+  wakeup latency, which makes servos chatter. PRECISE_MARGIN_NS is how
+  early to wake to start with. See precise.h.
+ */
+int PRECISE_EDGES = 1;
+module_param(PRECISE_EDGES, int, 0);
+
+int PRECISE_MARGIN_NS = 20000;
+module_param(PRECISE_MARGIN_NS, int, 0);
+
+static PRECISE edge_precise;
+
+/* counts of what was done, printed at the end */
+static int frame_count = 0;
+static int wake_count = 0;
+static int spin_count = 0;
+static int write_count = 0;
+static RTIME late_max = 0;
+
+#define RC_BIT(c) (0x01 << ((c) % 8))
+
+/*
+  We keep a shadow of each port, so that setting one servo's bit
+  doesn't mean reading the port first. See portio.h.
+ */
+static PORT_REG rc_reg[RC_PORT_NUM];
+
+/*
+  rc_update() clears the bits in 'clear' and sets the bits in 'set' on
+  port number 'p', with one write, unless there isn't a port, in which
+  case it just keeps the shadow.
+ */
+static void rc_update(int p, int clear, int set)
+{
+  if (0 != RC_PORTS[p]) {
+    port_update(&rc_reg[p], clear, set);
+  } else {
+    rc_reg[p].shadow = (rc_reg[p].shadow & ~clear) | set;
+  }
+  write_count++;
+}
+
+/* maps integer x in the range [a..b] to [c..d] */
+static int range_map(int a, int b, int c, int d, int x)
+{
+  if (a == b) return 0;
+
+  return c + (d - c)*(x - a)/(b - a);
+}
+
+/*
+  Map positions in [-1000, 1000] to times in [350, 2450] microseconds,
+  the range for the Futaba S3003 RC servos, which then need to be 
+  multiplied by 1000 for nanoseconds.
+ */
+#define PULSE_MIN_US 350
+#define PULSE_MAX_US 2450
+
+static RTIME position_to_period(int position)
+{
+  return nano2count(1000 * range_map(-1000, 1000, PULSE_MIN_US, PULSE_MAX_US, position));
+}
+
+/*
+  Each servo has a ring buffer of trajectory points. The FIFO handler
+  adds them at 'tail', and the RT task takes them off at 'head', so
+  neither has to lock out the other as long as each index is only
+  changed by one side, after the point itself is written or read. The
+  handler runs in Linux, which the RT task can preempt, maybe on
+  another CPU, so it's not enough to write them in that order in C:
+  the compiler and the CPU have to be kept from reordering them too,
+  with wmb() before 'tail' is changed, rmb() after the RT task reads
+  it, and mb() before the RT task changes 'head'.
+
+  A single position on FIFO 0 flushes the trajectory. The command
+  handler can't touch 'head', so it says where to flush up to, the
+  'tail' when the command came, and bumps 'flush_req'; the RT task
+  moves 'head' there on its next frame. Points that come on FIFO 1
+  after the command, before that frame, are kept.
+
+  'from' is where the current segment started, and 'prev' where the
+  one before it started, for the cubic. 'elapsed_us' is how far into
+  the current segment we are.
+ */
+typedef struct {
+  TRAJ_POINT point[TRAJ_POINTS];
+  volatile int head;
+  volatile int tail;
+  volatile int flush_req;	/* bumped by the command handler to flush */
+  volatile int flush_to;	/* the 'tail' to flush up to */
+  volatile int flush_pos;	/* the position to start from after */
+  int flush_done;		/* the last 'flush_req' the RT task did */
+  int mode;
+  int prev;
+  int from;
+  int elapsed_us;
+} TRAJ;
+
+static TRAJ traj[RC_MAX];
+static int traj_dropped = 0;	/* points that didn't fit */
+static int traj_points = 0;	/* points received */
+static int traj_batches = 0;	/* FIFO messages they came in */
+
+#define FRAME_US 20000		/* the frame period, in microseconds */
+#define TRAJ_NEXT(i) (((i) + 1) % TRAJ_POINTS)
+
+/*
+  traj_interp() returns the position 's' thousandths of the way from
+  'p0' to 'p1'. For TRAJ_CUBIC this is a Catmull-Rom spline, which
+  also looks at the point before 'p0', 'pm', and the one after 'p1',
+  'p2', so that the speed changes smoothly through each point:
+
+  p(s) = p0 + s(c1 + s(c2 + s c3)) / 2
+  c1 = p1 - pm
+  c2 = 2pm - 5p0 + 4p1 - p2
+  c3 = 3(p0 - p1) + p2 - pm
+
+  This is done in integers, dividing by 1000 after each multiply by
+  's' to stay in range. The points are taken as evenly spaced in
+  time, which is near enough if their 'dt_ms' don't vary too much.
+ */
+static int traj_interp(int mode, int pm, int p0, int p1, int p2, int s)
+{
+  int c1, c2, c3;
+
+  if (TRAJ_CUBIC != mode) {
+    return p0 + (p1 - p0) * s / 1000;
+  }
+
+  c1 = p1 - pm;
+  c2 = 2 * pm - 5 * p0 + 4 * p1 - p2;
+  c3 = 3 * (p0 - p1) + p2 - pm;
+
+  return p0 + ((c3 * s / 1000 + c2) * s / 1000 + c1) * s / 1000 / 2;
+}
+
+/*
+  traj_step() moves servo 'c' one frame along its trajectory, if it
+  has one, and sets its pulse width. With no points left it stays
+  where it ended up, so commands on FIFO 0 still work as before.
+ */
+static void traj_step(int c)
+{
+  TRAJ * tp = &traj[c];
+  TRAJ_POINT * pt;
+  int head, tail, req, to;
+  int pm, p2, s, pos;
+
+  head = tp->head;
+  req = tp->flush_req;
+  if (req != tp->flush_done) {
+    rmb();			/* 'flush_to' is as new as 'flush_req' */
+    to = tp->flush_to;
+    /* don't go past the tail, if it was moved since */
+    if ((to - head + TRAJ_POINTS) % TRAJ_POINTS <=
+	(tp->tail - head + TRAJ_POINTS) % TRAJ_POINTS) {
+      head = to;
+    }
+    tp->from = tp->prev = tp->flush_pos;
+    tp->elapsed_us = 0;
+    tp->flush_done = req;
+    mb();
+    tp->head = head;
+  }
+
+  tail = tp->tail;
+  rmb();			/* read the points only after 'tail' */
+  if (head == tail) {
+    return;
+  }
+
+  /*
+    Step past any points whose time has come, so a long frame or
+    short segments don't leave us behind.
+   */
+  tp->elapsed_us += FRAME_US;
+  while (head != tail &&
+	 tp->elapsed_us >= tp->point[head].dt_ms * 1000) {
+    tp->elapsed_us -= tp->point[head].dt_ms * 1000;
+    tp->prev = tp->from;
+    tp->from = tp->point[head].position;
+    head = TRAJ_NEXT(head);
+  }
+  mb();				/* done with the points before we free them */
+  tp->head = head;
+
+  if (head == tail) {
+    /* we got to the end */
+    tp->elapsed_us = 0;
+    pos = tp->from;
+  } else {
+    pt = &tp->point[head];
+    /* 'dt_ms' is at least 1, so this is thousandths of the segment */
+    s = tp->elapsed_us / pt->dt_ms;
+    pm = tp->prev;
+    p2 = (TRAJ_NEXT(head) != tail ?
+	  tp->point[TRAJ_NEXT(head)].position : pt->position);
+    pos = traj_interp(tp->mode, pm, tp->from, pt->position, p2, s);
+  }
+
+  if (pos < -1000) pos = -1000;
+  else if (pos > 1000) pos = 1000;
+  up_period[c] = position_to_period(pos);
+}
+
 static void up_func(int arg)
 {
   RTIME now;
@@ -49,21 +315,28 @@ static void up_func(int arg)
 
   while (1) {
     now = rt_get_time();
+    wake_count++;
+    for (t = 0; t < RC_CHANNELS; t++) {
+      traj_step(t);
+    }
     /*
       We write all bits, so we don't need to take care to leave
       some untouched.
      */
-    outb(0x00, LPT_PORT);
+    for (t = 0; t * 8 < RC_CHANNELS; t++) {
+      rc_update(t, 0xFF, 0x00);
+    }
 
     /*
       Schedule the other tasks that will write their individual bits.
       The start time is important, the period won't be used so we
       set it to a dummy nonzero value.
      */
-    for (t = 0; t < RC_NUM; t++) {
+    for (t = 0; t < RC_CHANNELS; t++) {
       rt_task_make_periodic(&down_task[t], now + up_period[t], 1);
     }
 
+    frame_count++;
     rt_task_wait_period();
   }
 
@@ -73,14 +346,15 @@ static void up_func(int arg)
 static void down_func(int which)
 {
   while (1) {
+    wake_count++;
     /*
       We write one bit, so we need to take care and leave others
-      untouched. We do this by reading in the byte, setting our bit,
-      and writing it back out. We run the risk of getting interrupted
-      between our read and write, which we eliminate by running all
-      these tasks at the same priority.
+      untouched. We do this by setting our bit in the port's shadow
+      and writing that out. We run the risk of getting interrupted
+      between changing the shadow and writing it, which we eliminate
+      by running all these tasks at the same priority.
      */
-    outb(inb(LPT_PORT) | (0x01 << which), LPT_PORT);
+    rc_update(which / 8, 0, RC_BIT(which));
 
     rt_task_suspend(rt_whoami());
   }
@@ -88,12 +362,111 @@ static void down_func(int which)
   return;
 }
 
-/* maps integer x in the range [a..b] to [c..d] */
-static int range_map(int a, int b, int c, int d, int x)
+/*
+  edge_func() is the edge scheduler. It's made periodic at the 20
+  millisecond frame rate like the up task, and starts each frame the
+  same way, but then takes a copy of the pulse widths, sorts the
+  servos by when their pulses end, and sleeps until each end in turn.
+  Servos whose pulses end within EDGE_WINDOW_NS of the first one still
+  to go are ended together, with one write per port, so servos at the
+  same position cost just one edge between them. An edge less than
+  EDGE_SPIN_NS away is spun to rather than slept until, so the pulse
+  ends cost at most one wakeup per EDGE_SPIN_NS of their spread, plus
+  one for the first, however many servos there are.
+
+  The bits for each port are gathered up in 'set' so that each port
+  is written just once per edge.
+ */
+static void edge_func(int arg)
 {
-  if (a == b) return 0;
+  static RTIME width[RC_MAX];	/* copy of 'up_period', for this frame */
+  static int order[RC_MAX];	/* servos sorted by width */
+  static int set[RC_PORT_NUM];	/* bits to set on each port */
+  RTIME frame_start, edge, window, spin, now;
+  int next, last;
+  int c, t, p;
 
-  return c + (d - c)*(x - a)/(b - a);
+  window = nano2count(EDGE_WINDOW_NS);
+  spin = nano2count(EDGE_SPIN_NS);
+
+  while (1) {
+    frame_start = rt_get_time();
+    wake_count++;
+
+    for (p = 0; p * 8 < RC_CHANNELS; p++) {
+      rc_update(p, 0xFF, 0x00);
+    }
+
+    for (c = 0; c < RC_CHANNELS; c++) {
+      traj_step(c);
+    }
+
+    /*
+      Copy the widths, since the FIFO handler can change them while
+      we're working, and insertion sort them. There are never so
+      many that a fancier sort would pay off.
+     */
+    for (c = 0; c < RC_CHANNELS; c++) {
+      width[c] = up_period[c];
+    }
+    for (c = 0; c < RC_CHANNELS; c++) {
+      t = c;
+      while (t > 0 && width[order[t - 1]] > width[c]) {
+	order[t] = order[t - 1];
+	t--;
+      }
+      order[t] = c;
+    }
+
+    next = 0;
+    while (next < RC_CHANNELS) {
+      /*
+	Gather up the servos whose pulses end within the window
+	starting at the next one's end.
+       */
+      edge = frame_start + width[order[next]];
+      for (last = next + 1; last < RC_CHANNELS; last++) {
+	if (frame_start + width[order[last]] > edge + window) break;
+      }
+
+      now = rt_get_time();
+      if (edge > now && edge - now <= spin) {
+	while (now < edge) {
+	  now = rt_get_time();
+	}
+	spin_count++;
+      } else {
+	if (PRECISE_EDGES) {
+	  precise_sleep_until(&edge_precise, edge);
+	} else {
+	  rt_sleep_until(edge);
+	}
+	now = rt_get_time();
+	wake_count++;
+      }
+      if (now > edge && now - edge > late_max) {
+	late_max = now - edge;
+      }
+
+      for (p = 0; p * 8 < RC_CHANNELS; p++) {
+	set[p] = 0;
+      }
+      for (; next < last; next++) {
+	c = order[next];
+	set[c / 8] |= RC_BIT(c);
+      }
+      for (p = 0; p * 8 < RC_CHANNELS; p++) {
+	if (0 != set[p]) {
+	  rc_update(p, 0, set[p]);
+	}
+      }
+    }
+
+    frame_count++;
+    rt_task_wait_period();
+  }
+
+  return;
 }
 
 static int fifo_handler(unsigned int fifo)
@@ -114,17 +487,11 @@ static int fifo_handler(unsigned int fifo)
   */
 
   if (command.which < 0) command.which = 0;
-  else if (command.which >= RC_NUM) command.which = RC_NUM;
+  else if (command.which >= RC_CHANNELS) command.which = RC_CHANNELS - 1;
 
   if (command.position < -1000) command.position = -1000;
   else if (command.position > 1000) command.position = 1000;
 
-  /*
-    Map positions in [-1000, 1000] to times in [350, 2450] microseconds,
-    the range for the Futaba S3003 RC servos, which then need to be 
-    multiplied by 1000 for nanoseconds.
-   */
-
   /*
     Since 'up_period[]' is a shared global variable, we should consider
     whether this needs mutual exclusion protection. These are small data,
@@ -132,8 +499,62 @@ static int fifo_handler(unsigned int fifo)
     on atomically on Pentiums, but not 486s. Here we'll assume it's OK.
     Who's running 486s anymore?
    */  
-  up_period[command.which] = 
-    nano2count(1000 * range_map(-1000, 1000, 350, 2450, command.position));
+  up_period[command.which] = position_to_period(command.position);
+
+  /*
+    A single position replaces any trajectory the servo is following,
+    and is where the next one starts from. The RT task does the flush,
+    on its next frame.
+   */
+  traj[command.which].flush_to = traj[command.which].tail;
+  traj[command.which].flush_pos = command.position;
+  wmb();			/* so the RT task sees these with the bump */
+  traj[command.which].flush_req++;
+
+  return 0;
+}
+
+/*
+  traj_handler() adds the points in each batch on the trajectory FIFO
+  to the end of the servo's buffer. Unlike commands, which replace each
+  other, every point counts, so we read every message. Points that
+  don't fit are dropped; the application should keep no more than
+  TRAJ_POINTS queued, going by their times.
+ */
+static int traj_handler(unsigned int fifo)
+{
+  TRAJ_STRUCT batch;
+  TRAJ * tp;
+  TRAJ_POINT * pt;
+  int next;
+  int t;
+
+  while (sizeof(batch) == rtf_get(TRAJ_FIFO, &batch, sizeof(batch))) {
+    traj_batches++;
+    if (batch.which < 0 || batch.which >= RC_CHANNELS) continue;
+    if (batch.count > TRAJ_BATCH) batch.count = TRAJ_BATCH;
+    tp = &traj[batch.which];
+    tp->mode = batch.mode;
+
+    for (t = 0; t < batch.count; t++) {
+      traj_points++;
+      next = TRAJ_NEXT(tp->tail);
+      if (next == tp->head) {
+	traj_dropped++;
+	continue;
+      }
+      pt = &tp->point[tp->tail];
+      pt->dt_ms = batch.point[t].dt_ms;
+      if (pt->dt_ms < 1) pt->dt_ms = 1;
+      else if (pt->dt_ms > TRAJ_DT_MAX) pt->dt_ms = TRAJ_DT_MAX;
+      pt->position = batch.point[t].position;
+      if (pt->position < -1000) pt->position = -1000;
+      else if (pt->position > 1000) pt->position = 1000;
+      /* now that the point is there, let the RT task see it */
+      wmb();
+      tp->tail = next;
+    }
+  }
 
   return 0;
 }
@@ -155,8 +576,23 @@ int init_module(void)
   int t;
   RTIME down_period;		/* 20 millisecond baseline period */
 
+  if (RC_CHANNELS < 1) RC_CHANNELS = 1;
+  else if (RC_CHANNELS > RC_MAX) RC_CHANNELS = RC_MAX;
+  if (EDGE_SPIN_NS < 0) EDGE_SPIN_NS = 0;
+
+  if (0 != portio_trace_init()) {
+    printk("can't allocate port trace\n");
+  }
+  for (t = 0; t < RC_PORT_NUM; t++) {
+    if (0 != RC_PORTS[t]) {
+      port_init(&rc_reg[t], RC_PORTS[t]);
+    }
+  }
+
   rt_set_oneshot_mode();
   start_rt_timer(1);
+  /* after starting the timer, so counts are right */
+  precise_init(&edge_precise, PRECISE_MARGIN_NS, 2000);
   
   retval = rtf_create(0, FIFOSIZE);
   if (retval) {
@@ -171,26 +607,51 @@ int init_module(void)
     return retval;
   }
 
-  retval = rt_task_init(&up_task, up_func, 0, STACKSIZE,
-			RT_LOWEST_PRIORITY, 0, 0);
+  retval = rtf_create(TRAJ_FIFO, FIFOSIZE);
   if (retval) {
-    printk("can't create up task\n");
+    printk("could not create trajectory RT-FIFO\n");
+    return retval;
+  }
+  rtf_reset(TRAJ_FIFO);
+
+  retval = rtf_create_handler(TRAJ_FIFO, traj_handler);
+  if (retval) {
+    printk("could not create trajectory RT-FIFO handler\n");
     return retval;
   }
 
-  for (t = 0; t < RC_NUM; t++) {
+  for (t = 0; t < RC_CHANNELS; t++) {
     up_period[t] = nano2count(1000000);
-    retval = rt_task_init(&down_task[t], down_func,
-			  t,	/* give each task a unique ID */
-			  STACKSIZE, RT_LOWEST_PRIORITY, 0, 0);
-    if (retval) {
-      printk("can't create up task %d\n", t);
-      return retval;
+    /* trajectories start from where the 1 millisecond pulse puts it */
+    traj[t].from = traj[t].prev = range_map(350, 2450, -1000, 1000, 1000);
+  }
+
+  /*
+    With the edge scheduler, the up task is the edge task, and there
+    are no down tasks.
+   */
+  retval = rt_task_init(&up_task,
+			EDGE_SCHEDULER == PWM_MODE ? edge_func : up_func,
+			0, STACKSIZE, RT_LOWEST_PRIORITY, 0, 0);
+  if (retval) {
+    printk("can't create up task\n");
+    return retval;
+  }
+
+  if (TASK_PER_CHANNEL == PWM_MODE) {
+    for (t = 0; t < RC_CHANNELS; t++) {
+      retval = rt_task_init(&down_task[t], down_func,
+			    t,	/* give each task a unique ID */
+			    STACKSIZE, RT_LOWEST_PRIORITY, 0, 0);
+      if (retval) {
+	printk("can't create down task %d\n", t);
+	return retval;
+      }
     }
   }
 
   /*
-    Start just the up task. This will schedule the down tasks.
+    Start just the up task. This will schedule the down tasks, if any.
    */
   down_period = nano2count(20000000);
   retval = rt_task_make_periodic(&up_task,
@@ -215,11 +676,44 @@ void cleanup_module(void)
    */
   rt_task_delete(&up_task);
 
-  for (t = 0; t < RC_NUM; t++) {
-    rt_task_delete(&down_task[t]);
+  if (TASK_PER_CHANNEL == PWM_MODE) {
+    for (t = 0; t < RC_CHANNELS; t++) {
+      rt_task_delete(&down_task[t]);
+    }
   }
 
   rtf_destroy(0);
+  rtf_destroy(TRAJ_FIFO);
+  portio_trace_exit();
+
+  printk("%s, %d servos: %d frames, %d wakeups, %d port writes\n",
+	 EDGE_SCHEDULER == PWM_MODE ? "edge scheduler" : "task per servo",
+	 RC_CHANNELS, frame_count, wake_count, write_count);
+  if (frame_count > 0) {
+    printk("per frame: %d wakeups, %d port writes\n",
+	   wake_count / frame_count, write_count / frame_count);
+  }
+  if (EDGE_SCHEDULER == PWM_MODE && EDGE_SPIN_NS > 0 && frame_count > 0) {
+    printk("per frame: %d edges spun to, wakeups at most %d for any "
+	   "number of servos\n", spin_count / frame_count,
+	   2 + (PULSE_MAX_US - PULSE_MIN_US) * 1000 / EDGE_SPIN_NS);
+  }
+  printk("trajectories: %d points in %d batches, %d dropped\n",
+	 traj_points, traj_batches, traj_dropped);
+  if (EDGE_SCHEDULER == PWM_MODE) {
+    printk("latest pulse end: %d nsecs\n", (int) count2nano(late_max));
+    if (PRECISE_EDGES) {
+      precise_report(&edge_precise, "edges");
+    }
+  }
+#ifdef PORTIO_COUNT
+  for (t = 0; t < RC_PORT_NUM; t++) {
+    if (0 != RC_PORTS[t]) {
+      printk("port 0x%x reads/writes = %lu/%lu\n",
+	     RC_PORTS[t], rc_reg[t].reads, rc_reg[t].writes);
+    }
+  }
+#endif
 
   return;
 }
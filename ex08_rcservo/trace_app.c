@@ -0,0 +1,233 @@
+/*
+  trace_app.c
+
+  Checks the timing of port writes recorded by RT tasks built with
+  'make PORTIO_TRACE=1', which works for any of the examples that use
+  portio.h, not just this one. It picks one bit of one port out of the
+  trace, rebuilds its waveform as a list of edges, and compares the
+  periods and the high and low times against what they should be.
+
+  Usage: trace_app [-p <port>] [-b <bit>] [-P <period>] [-H <high>]
+                   [-L <low>] [-t <tolerance>] [-d]
+
+  <port> is the port address, e.g., 0x378, by default the first one in
+  the trace. <bit> is 0..7, by default 0. <period>, <high> and <low>
+  are what they should be, in microseconds; any left out are just
+  reported, not checked. With -t, we return 1 if any of them is ever
+  off by more than <tolerance> microseconds, so this can be used in
+  scripts. With -d, the edges are printed too, as time in microseconds
+  and the new level, for plotting.
+
+  For example, ex01 toggles bit 1 of the speaker port every
+  millisecond, so
+
+  trace_app -p 0x61 -b 1 -P 2000 -H 1000 -L 1000 -t 50
+
+  checks that each half-cycle is within 50 microseconds. In ex08 the
+  pulses to the servos are the times the bits are low, so -L is the
+  pulse width and -P is the 20 millisecond frame.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include <stdio.h>		/* printf() */
+#include <stdlib.h>		/* atoi(), atof(), strtol() */
+#include <string.h>		/* strcmp() */
+#include <math.h>		/* sqrt() */
+#include <sys/mman.h>		/* PROT_READ, needed for rtai_shm.h */
+#include <sys/types.h>		/* off_t, needed for rtai_shm.h */
+#include <sys/fcntl.h>		/* O_RDWR, needed for rtai_shm.h */
+#include <rtai_shm.h>		/* rtai_malloc,free() */
+#include "portio_trace.h"	/* PORTIO_LOG, PORTIO_RECORD */
+
+/*
+  Running statistics for one kind of interval, in microseconds.
+ */
+typedef struct {
+  const char * name;
+  double expected;		/* what it should be, or < 0 if unknown */
+  int num;
+  double sum;
+  double sumsq;
+  double min;
+  double max;
+  double worst;			/* largest error from 'expected' */
+} STATS;
+
+static void stats_init(STATS * s, const char * name, double expected)
+{
+  s->name = name;
+  s->expected = expected;
+  s->num = 0;
+  s->sum = s->sumsq = 0.0;
+  s->min = s->max = s->worst = 0.0;
+}
+
+static void stats_add(STATS * s, double x)
+{
+  double err;
+
+  if (0 == s->num || x < s->min) s->min = x;
+  if (0 == s->num || x > s->max) s->max = x;
+  s->num++;
+  s->sum += x;
+  s->sumsq += x * x;
+  if (s->expected >= 0.0) {
+    err = fabs(x - s->expected);
+    if (err > s->worst) s->worst = err;
+  }
+}
+
+/*
+  Prints the statistics. The jitter is the standard deviation. Returns
+  1 if the worst error is over 'tolerance', if it's given, else 0.
+ */
+static int stats_print(STATS * s, double tolerance)
+{
+  double mean, var;
+
+  if (0 == s->num) {
+    printf("%s: none\n", s->name);
+    return 0;
+  }
+
+  mean = s->sum / s->num;
+  var = s->sumsq / s->num - mean * mean;
+  printf("%s: %d, mean %.3f, min %.3f, max %.3f, jitter %.3f usecs\n",
+	 s->name, s->num, mean, s->min, s->max, var > 0.0 ? sqrt(var) : 0.0);
+  if (s->expected < 0.0) {
+    return 0;
+  }
+  printf("%s: expected %.3f, mean error %.3f, worst error %.3f usecs\n",
+	 s->name, s->expected, mean - s->expected, s->worst);
+
+  return tolerance >= 0.0 && s->worst > tolerance;
+}
+
+int main(int argc, char * argv[])
+{
+  PORTIO_LOG * log;
+  PORTIO_RECORD * rec;
+  unsigned int count, first, t;
+  int port = -1;
+  int mask = 0x01;
+  double period = -1.0, high = -1.0, low = -1.0, tolerance = -1.0;
+  int dump = 0;
+  STATS period_stats, high_stats, low_stats;
+  int level, was;
+  double now, last_edge, last_rise;
+  int edges, rises;
+  int retval;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (! strcmp(argv[i], "-d")) {
+      dump = 1;
+    } else if (i + 1 >= argc) {
+      fprintf(stderr, "missing value for %s\n", argv[i]);
+      return 1;
+    } else if (! strcmp(argv[i], "-p")) {
+      port = strtol(argv[++i], NULL, 0);
+    } else if (! strcmp(argv[i], "-b")) {
+      mask = 0x01 << atoi(argv[++i]);
+    } else if (! strcmp(argv[i], "-P")) {
+      period = atof(argv[++i]);
+    } else if (! strcmp(argv[i], "-H")) {
+      high = atof(argv[++i]);
+    } else if (! strcmp(argv[i], "-L")) {
+      low = atof(argv[++i]);
+    } else if (! strcmp(argv[i], "-t")) {
+      tolerance = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  log = rtai_malloc(PORTIO_TRACE_KEY, sizeof(PORTIO_LOG));
+  if (0 == log) {
+    fprintf(stderr, "can't allocate shared memory\n");
+    return 1;
+  }
+  if (log->magic != PORTIO_TRACE_MAGIC ||
+      log->version != PORTIO_TRACE_VERSION ||
+      log->size != PORTIO_TRACE_LEN ||
+      log->bytes != sizeof(PORTIO_LOG)) {
+    fprintf(stderr, "no port trace, or its layout doesn't match; "
+	    "load an RT task built with PORTIO_TRACE=1\n");
+    rtai_free(PORTIO_TRACE_KEY, log);
+    return 1;
+  }
+
+  /*
+    Take what's there now. If the trace has wrapped around, the oldest
+    records left start just after the newest.
+   */
+  count = log->count;
+  first = (count > PORTIO_TRACE_LEN ? count - PORTIO_TRACE_LEN : 0);
+
+  stats_init(&period_stats, "period", period);
+  stats_init(&high_stats, "high", high);
+  stats_init(&low_stats, "low", low);
+
+  was = -1;			/* don't know the level yet */
+  last_edge = last_rise = 0.0;
+  edges = rises = 0;
+  for (t = first; t < count; t++) {
+    rec = &log->record[t % PORTIO_TRACE_LEN];
+    if (-1 == port) {
+      port = rec->port;
+    }
+    if (rec->port != port) {
+      continue;
+    }
+    level = (rec->value & mask) ? 1 : 0;
+    now = rec->ns * 1.0e-3;
+    if (-1 == was) {
+      /* the first record just tells us where we start */
+      was = level;
+      if (dump) printf("%.3f %d\n", now, level);
+      continue;
+    }
+    if (level == was) {
+      /* a write that didn't change our bit */
+      continue;
+    }
+
+    /*
+      An edge. The time since the last edge is how long we were at the
+      old level, if we've seen a previous edge to measure from.
+     */
+    if (dump) printf("%.3f %d\n", now, level);
+    if (edges > 0) {
+      stats_add(was ? &high_stats : &low_stats, now - last_edge);
+    }
+    if (level) {
+      if (rises > 0) {
+	stats_add(&period_stats, now - last_rise);
+      }
+      last_rise = now;
+      rises++;
+    }
+    last_edge = now;
+    was = level;
+    edges++;
+  }
+
+  printf("port 0x%x mask 0x%02x: %u records, %d edges\n",
+	 port, mask, count - first, edges);
+  retval = 0;
+  retval |= stats_print(&period_stats, tolerance);
+  retval |= stats_print(&high_stats, tolerance);
+  retval |= stats_print(&low_stats, tolerance);
+  if (retval) {
+    printf("timing off by more than %.3f usecs\n", tolerance);
+  }
+
+  rtai_free(PORTIO_TRACE_KEY, log);
+
+  return retval;
+}
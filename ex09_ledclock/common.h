@@ -0,0 +1,47 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+/*
+  The pattern sent to the RT task is PATTERN_SIZE bytes at most, one
+  byte per column of LEDs.
+ */
+#define PATTERN_SIZE 1024
+
+/*
+  Changes to the pattern are sent as patches, a PATCH_HEADER followed
+  by 'length' bytes of new columns that go at 'offset'. 'count' is the
+  new length of the whole pattern; if it's shorter than before, the
+  columns past it are cleared. Clearing the whole thing is just a
+  header with all zeros. This way only what changed goes through the
+  FIFO, not the whole pattern each time.
+ */
+typedef struct {
+  int offset;			/* where the new bytes go */
+  int length;			/* how many new bytes follow */
+  int count;			/* new length of the pattern */
+} PATCH_HEADER;
+
+/*
+  The FIFO has to hold at least one whole patch, header and all, or a
+  patch of the whole pattern won't go in with one write. We make it
+  big enough for two, so the application can send the next while the
+  RT task is still reading one.
+ */
+#define PATCH_FIFO_SIZE (2 * (sizeof(PATCH_HEADER) + PATTERN_SIZE))
+
+/*
+  When the RT task simulates the swing, with SIM_PERIOD_NS set, it
+  records the swing in the port trace along with the LED writes, on
+  ports that aren't real: each sensor pulse it makes up as a write
+  of SIM_SENSOR_PULSE to SIM_SENSOR_PORT, and each time the wand
+  reaches an end as a write to SIM_END_PORT, of SIM_END_LEFT or
+  SIM_END_RIGHT. 'wand_app' uses these to work out where the wand was
+  when each column was written.
+ */
+#define SIM_SENSOR_PORT 0x0001
+#define SIM_SENSOR_PULSE 1
+#define SIM_END_PORT 0x0002
+#define SIM_END_LEFT 0
+#define SIM_END_RIGHT 1
+
+#endif /* COMMON_H */
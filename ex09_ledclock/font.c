@@ -0,0 +1,93 @@
+/*
+  font.c
+
+  Looking up fonts, and rendering strings with them, for the LED clock.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include <string.h>
+#include "common.h"		/* PATTERN_SIZE */
+#include "font.h"
+
+const FONT * font_find(const char * name)
+{
+  int t;
+
+  for (t = 0; t < font_count; t++) {
+    if (! strcmp(fonts[t]->name, name)) {
+      return fonts[t];
+    }
+  }
+
+  return 0;
+}
+
+/*
+  The render cache holds the last CACHE_SIZE strings rendered, up to
+  CACHE_STRLEN characters long. When it's full, the one used longest
+  ago is replaced.
+ */
+enum {CACHE_SIZE = 8, CACHE_STRLEN = 128};
+
+typedef struct {
+  const FONT * font;		/* 0 if this one is empty */
+  char str[CACHE_STRLEN];
+  int max;
+  int length;
+  unsigned long used;		/* when it was last used */
+  unsigned char columns[PATTERN_SIZE];
+} CACHE_ENTRY;
+
+static CACHE_ENTRY cache[CACHE_SIZE];
+static unsigned long cache_clock = 0;
+
+const unsigned char * font_render(const FONT * font, const char * str,
+				  int max, int * length)
+{
+  CACHE_ENTRY * entry;
+  const unsigned char * glyph;
+  int width;
+  int t;
+
+  if (max > PATTERN_SIZE) max = PATTERN_SIZE;
+  cache_clock++;
+
+  /*
+    Look for it, and note the oldest entry in case it's not there.
+   */
+  entry = &cache[0];
+  for (t = 0; t < CACHE_SIZE; t++) {
+    if (cache[t].font == font && cache[t].max == max &&
+	! strcmp(cache[t].str, str)) {
+      cache[t].used = cache_clock;
+      *length = cache[t].length;
+      return cache[t].columns;
+    }
+    if (cache[t].used < entry->used) {
+      entry = &cache[t];
+    }
+  }
+
+  /*
+    Render it, keeping it if it's short enough to fit in the cache.
+   */
+  entry->font = (strlen(str) < CACHE_STRLEN ? font : 0);
+  strncpy(entry->str, str, CACHE_STRLEN - 1);
+  entry->str[CACHE_STRLEN - 1] = 0;
+  entry->max = max;
+  entry->used = cache_clock;
+  entry->length = 0;
+  for (; *str; str++) {
+    glyph = font_glyph(font, *str, &width);
+    if (entry->length + width > max) break;
+    memcpy(&entry->columns[entry->length], glyph, width);
+    entry->length += width;
+  }
+
+  *length = entry->length;
+  return entry->columns;
+}
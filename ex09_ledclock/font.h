@@ -0,0 +1,45 @@
+#ifndef FONT_H
+#define FONT_H
+
+/*
+  font.h
+
+  Fonts for the LED clock, as tables of LED columns made at build time
+  by fontc from the font files. Characters can be different widths.
+*/
+
+typedef struct {
+  const char * name;		/* e.g., "default8x9" or "default8x9-prop" */
+  int height;			/* LEDs per column */
+  const unsigned char * width;	/* columns in each of the 256 characters */
+  const unsigned short * offset; /* where each starts in 'columns' */
+  const unsigned char * columns; /* all the characters' columns */
+} FONT;
+
+/* all the fonts, in fonts.c, which is made by fontc */
+extern const FONT * const fonts[];
+extern const int font_count;
+
+/*
+  font_find() returns the font named 'name', or 0 if there's none.
+ */
+extern const FONT * font_find(const char * name);
+
+/*
+  font_glyph() returns the columns of character 'c', and puts how many
+  there are in 'w'.
+ */
+#define font_glyph(font, c, w) \
+  (*(w) = (font)->width[(unsigned char) (c)], \
+   &(font)->columns[(font)->offset[(unsigned char) (c)]])
+
+/*
+  font_render() returns the columns for the string 'str', and puts
+  how many there are in 'length', at most 'max'. Recently rendered
+  strings are kept, so rendering one again is just a lookup. The
+  columns are good until the next call.
+ */
+extern const unsigned char * font_render(const FONT * font, const char * str,
+					 int max, int * length);
+
+#endif /* FONT_H */
@@ -0,0 +1,177 @@
+/*
+  fontc.c
+
+  Font compiler for the LED clock. Reads 8x9 font files, 9 bytes per
+  character for 256 characters, each byte a row of 8 pixels with the
+  leftmost in the top bit, and writes out C source for the fonts as
+  tables of LED columns, ready to send to the RT task. The LEDs are a
+  column of 8, with the top one in the top bit, and the 9th row of the
+  font is left off.
+
+  Each font file makes two fonts: one with the name of the file, where
+  every character is 8 columns wide, and one with "-prop" added to the
+  name, where the blank columns on either side of each character are
+  dropped and one blank column is put after it, so narrow characters
+  like 'i' take less room. Blank characters, like space, are 4 columns
+  there.
+
+  Usage: fontc <font file> ... > fonts.c
+
+  The output defines 'fonts[]' and 'font_count', as declared in
+  font.h, and is built into ledclock_app, so it doesn't have to read or
+  convert any fonts when it starts.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+enum {GLYPHS = 256, ROWS = 9, COLS = 8, BLANK_WIDTH = 4};
+
+/*
+  column() returns column 'col' of glyph 'glyph' in 'font', as the
+  LEDs see it.
+ */
+static unsigned char column(unsigned char * font, int glyph, int col)
+{
+  unsigned char c = 0;
+  int row;
+
+  for (row = 0; row < COLS; row++) {
+    if (font[glyph * ROWS + row] & (0x80 >> col)) {
+      c |= 0x80 >> row;
+    }
+  }
+
+  return c;
+}
+
+/*
+  ident() makes a C identifier out of 'name', in 'buf'.
+ */
+static char * ident(const char * name, const char * suffix, char * buf)
+{
+  char * ptr = buf;
+
+  *ptr++ = 'f';
+  *ptr++ = '_';
+  for (; *name; name++) {
+    *ptr++ = isalnum((unsigned char) *name) ? *name : '_';
+  }
+  strcpy(ptr, suffix);
+
+  return buf;
+}
+
+/*
+  emit() writes out one font, fixed or proportional.
+ */
+static void emit(unsigned char * font, const char * name, int prop)
+{
+  char id[256];
+  int width[GLYPHS];
+  int first[GLYPHS];
+  int offset;
+  int g, c;
+
+  ident(name, prop ? "_prop" : "", id);
+
+  for (g = 0; g < GLYPHS; g++) {
+    first[g] = 0;
+    width[g] = COLS;
+    if (! prop) continue;
+    while (first[g] < COLS && 0 == column(font, g, first[g])) {
+      first[g]++;
+    }
+    if (COLS == first[g]) {
+      first[g] = 0;
+      width[g] = BLANK_WIDTH;
+      continue;
+    }
+    for (c = COLS - 1; 0 == column(font, g, c); c--);
+    width[g] = c - first[g] + 2;	/* one blank after */
+  }
+
+  printf("static const unsigned char %s_columns[] = {\n", id);
+  for (g = 0; g < GLYPHS; g++) {
+    printf("  ");
+    for (c = 0; c < width[g]; c++) {
+      /* the blank after a proportional character may be past the end */
+      printf("0x%02x,", first[g] + c < COLS ? column(font, g, first[g] + c) : 0);
+    }
+    printf("\t/* %d */\n", g);
+  }
+  printf("};\n\n");
+
+  printf("static const unsigned char %s_width[%d] = {", id, GLYPHS);
+  for (g = 0; g < GLYPHS; g++) {
+    printf("%s%d,", g % 16 ? " " : "\n  ", width[g]);
+  }
+  printf("\n};\n\n");
+
+  printf("static const unsigned short %s_offset[%d] = {", id, GLYPHS);
+  for (offset = 0, g = 0; g < GLYPHS; g++) {
+    printf("%s%d,", g % 8 ? " " : "\n  ", offset);
+    offset += width[g];
+  }
+  printf("\n};\n\n");
+
+  printf("static const FONT %s = {\n", id);
+  printf("  \"%s%s\", %d, %s_width, %s_offset, %s_columns\n",
+	 name, prop ? "-prop" : "", COLS, id, id, id);
+  printf("};\n\n");
+}
+
+int main(int argc, char * argv[])
+{
+  unsigned char font[GLYPHS * ROWS];
+  const char * name;
+  char id[256];
+  FILE * fp;
+  int t;
+
+  printf("/* generated by fontc from the font files, don't edit */\n\n");
+  printf("#include \"font.h\"\n\n");
+
+  for (t = 1; t < argc; t++) {
+    if (strlen(argv[t]) > 200) {
+      fprintf(stderr, "fontc: name too long: %s\n", argv[t]);
+      return 1;
+    }
+    if (NULL == (fp = fopen(argv[t], "rb"))) {
+      fprintf(stderr, "fontc: %s: %s\n", argv[t], strerror(errno));
+      return 1;
+    }
+    if (1 != fread(font, sizeof(font), 1, fp)) {
+      fprintf(stderr, "fontc: %s: not a %d-byte font\n", argv[t],
+	      (int) sizeof(font));
+      fclose(fp);
+      return 1;
+    }
+    fclose(fp);
+
+    /* the font is named for the file, without any directory */
+    name = strrchr(argv[t], '/');
+    name = (NULL == name ? argv[t] : name + 1);
+    emit(font, name, 0);
+    emit(font, name, 1);
+  }
+
+  printf("const FONT * const fonts[] = {\n");
+  for (t = 1; t < argc; t++) {
+    name = strrchr(argv[t], '/');
+    name = (NULL == name ? argv[t] : name + 1);
+    printf("  &%s,\n", ident(name, "", id));
+    printf("  &%s,\n", ident(name, "_prop", id));
+  }
+  printf("  0\n};\n\n");
+  printf("const int font_count = %d;\n", 2 * (argc - 1));
+
+  return 0;
+}
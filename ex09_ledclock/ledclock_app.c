@@ -20,13 +20,13 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <termios.h>
+#include "common.h"		/* PATTERN_SIZE, PATCH_HEADER */
+#include "font.h"		/* FONT, font_find(), font_render() */
 
-unsigned char vfont[9 * 256];
-unsigned char hfont[9 * 256];
-unsigned char obuf[1024];
+unsigned char obuf[PATTERN_SIZE];
 
 unsigned char key_in();
-void tofifo(unsigned char c, int n);
+void topatch(int offset, int length, int count);
 static int ff;
 
 static int done = 0;
@@ -37,30 +37,57 @@ static void quit(int sig)
   return;
 }
 
-int main()
+/* how many seconds each message is shown with -m */
+#define MESSAGE_SECS 5
+#define MESSAGE_MAX 16
+
+/*
+  Usage: ledclock_app [-f <font>] [-m <message> ...]
+
+  <font> is one of the fonts built in by fontc, by default
+  "default8x9", or "default8x9-prop" for proportional spacing. With
+  no -m, characters typed are shown as they come. With one or more -m,
+  the messages are shown in turn, MESSAGE_SECS seconds each. These are
+  rendered once and then come from the font cache, so going around
+  again costs just the write to the FIFO.
+ */
+int main(int argc, char * argv[])
 {
-  FILE *fn;
+  const char * font_name = "default8x9";
+  const char * message[MESSAGE_MAX];
+  int messages = 0;
+  const FONT * font;
+  const unsigned char * glyph;
+  const unsigned char * columns;
+  /* where each character typed starts, with the end after the last */
+  int start[PATTERN_SIZE + 1];
   unsigned char c;
-  int i, j, n = 0;
-
-  if ((fn = fopen("default8x9", "r")) == 0) {
-    fprintf(stderr, "fopen(default8x9) : %s\n", strerror(errno));
+  int i, n = 0, width, length;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      fprintf(stderr, "missing value for %s\n", argv[i]);
+      return 1;
+    } else if (! strcmp(argv[i], "-f")) {
+      font_name = argv[++i];
+    } else if (! strcmp(argv[i], "-m")) {
+      if (messages < MESSAGE_MAX) {
+	message[messages++] = argv[++i];
+      } else {
+	i++;
+      }
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
   }
-  fread(vfont, 9 * 256, 1, fn);
-  fclose(fn);
-
-  for (i = 0; i < 256; i++) {
-    for (c = 0, j = 0; j < 8; j++) {
-      c = ((vfont[(i * 9) + 7] & 1 << j) ? 1 : 0) << 0;
-      c |= ((vfont[(i * 9) + 6] & 1 << j) ? 1 : 0) << 1;
-      c |= ((vfont[(i * 9) + 5] & 1 << j) ? 1 : 0) << 2;
-      c |= ((vfont[(i * 9) + 4] & 1 << j) ? 1 : 0) << 3;
-      c |= ((vfont[(i * 9) + 3] & 1 << j) ? 1 : 0) << 4;
-      c |= ((vfont[(i * 9) + 2] & 1 << j) ? 1 : 0) << 5;
-      c |= ((vfont[(i * 9) + 1] & 1 << j) ? 1 : 0) << 6;
-      c |= ((vfont[(i * 9) + 0] & 1 << j) ? 1 : 0) << 7;
-      hfont[(i * 9) + (7 - j)] = c;
+
+  if (0 == (font = font_find(font_name))) {
+    fprintf(stderr, "no font %s; the fonts are:\n", font_name);
+    for (i = 0; i < font_count; i++) {
+      fprintf(stderr, "  %s\n", fonts[i]->name);
     }
+    return 1;
   }
 
   if ((ff = open("/dev/rtf0", O_WRONLY)) < 0) {
@@ -70,39 +97,67 @@ int main()
   done = 0;
   signal(SIGINT, quit);
 
+  if (messages > 0) {
+    for (i = 0; ! done; i = (i + 1) % messages) {
+      columns = font_render(font, message[i], sizeof(obuf), &length);
+      memcpy(obuf, columns, length);
+      topatch(0, length, length);
+      sleep(MESSAGE_SECS);
+    }
+    return 0;
+  }
+
+  start[0] = 0;
   while (! done) {
     usleep(100000);
     if ((c = key_in()) == 0) {
       continue;
     }
-    if (n * 8 >= sizeof(obuf) || c == '\n' || c == '\r') {
+    if (c == '\n' || c == '\r') {
       // clear the line
       memset(obuf, 0, sizeof(obuf));
-      write(ff, obuf, sizeof(obuf));
+      topatch(0, 0, 0);
       n = 0;
       continue;
     }
-    n++;
     if (c == 127) {
-      n--;
-      if (n == 0) {
-	continue;
+      // back up over the last character
+      if (n > 0) {
+	n--;
+	topatch(start[n], 0, start[n]);
       }
-      tofifo(' ', n);
-      n--;
       continue;
     }
-    tofifo(c, n);
+    glyph = font_glyph(font, c, &width);
+    if (start[n] + width > sizeof(obuf)) {
+      continue;
+    }
+    memcpy(&obuf[start[n]], glyph, width);
+    start[n + 1] = start[n] + width;
+    topatch(start[n], width, start[n + 1]);
+    n++;
   }
 
   return 0;
 }
 
-void tofifo(unsigned char c, int n)
+/*
+  topatch() sends the 'length' bytes of 'obuf' at 'offset' to the RT
+  task, saying the pattern is now 'count' bytes long, all in one write
+  so the header and bytes stay together in the FIFO. The FIFO holds
+  PATCH_FIFO_SIZE bytes, room for the biggest patch there is.
+ */
+void topatch(int offset, int length, int count)
 {
-  //fprintf(stderr, "n=%d, %d\n", n, c);
-  memcpy(&obuf[(n - 1) * 8], &hfont[9 * c], 8);
-  write(ff, obuf, n * 8);
+  unsigned char buf[sizeof(PATCH_HEADER) + PATTERN_SIZE];
+  PATCH_HEADER patch;
+
+  patch.offset = offset;
+  patch.length = length;
+  patch.count = count;
+  memcpy(buf, &patch, sizeof(patch));
+  memcpy(buf + sizeof(patch), &obuf[offset], length);
+  write(ff, buf, sizeof(patch) + length);
 }
 
 unsigned char key_in()
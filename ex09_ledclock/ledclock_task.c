@@ -11,9 +11,12 @@
 #include <linux/version.h>
 #include <linux/sched.h>
 #include <asm/io.h>
+#include "portio.h"		/* PORT_REG, port_write() */
+#include "precise.h"		/* PRECISE, precise_sleep_until() */
 #include "rtai.h"
 #include "rtai_sched.h"
 #include "rtai_fifos.h"
+#include "common.h"		/* PATTERN_SIZE, PATCH_HEADER, SIM_xxx */
 
 /*
   THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
@@ -34,20 +37,171 @@ MODULE_LICENSE("GPL");
 
 #define BASE_PER (1e9 / 7000)	/* 142857 */
 
+/*
+  The timings above are for a swing that repeats every PERIOD_NOM_NS,
+  with drawing starting START_NOM_NS after the long gap ends. When
+  the swing speeds up or slows down, everything should scale with it.
+ */
+#define PERIOD_NOM_NS 80000000
+#define START_NOM_NS 34000000
+
+/*
+  With TRACK_PHASE set, we track the swing with an alpha-beta filter,
+  the steady-state form of a Kalman filter for something moving at a
+  nearly constant rate. Each cycle it predicts when the next long gap
+  will end, and when it does, it corrects the prediction by a quarter
+  of the error, and the period by a sixteenth of it. This smooths out
+  the jitter in the interrupt times, and follows the swing as it
+  changes. Drawing then starts at the filtered time plus the
+  scaled-up start delay, with the column period scaled the same way.
+
+  If the error is ever more than a quarter of the period, we've lost
+  track, and start over from the next two long gaps. Until we've got
+  it, we use the fixed timing.
+ */
+int TRACK_PHASE = 1;
+module_param(TRACK_PHASE, int, 0);
+
+#define PERIOD_MIN_NS 40000000	/* shortest believable swing */
+#define PERIOD_MAX_NS 200000000	/* longest */
+
+static long track_period = 0;	/* estimated period, 0 if not locked */
+static long long track_phase = 0; /* filtered time of the last long gap */
+static long long track_next = 0; /* predicted time of the next one */
+static long long track_last = 0; /* raw time of the last one */
+static int track_locks = 0;	/* how many times we locked on */
+static int track_lost = 0;	/* how many times we lost it */
+static long track_err_max = 0;	/* largest error while locked */
+
+/*
+  track_long_gap() updates the tracker with the time 'now' that a
+  long gap ended. It's called from the interrupt handler.
+ */
+static void track_long_gap(long long now)
+{
+  long long err;
+  long long last = track_last;
+
+  track_last = now;
+
+  if (0 == track_period) {
+    /* not locked; lock on if the last gap was long ago enough */
+    track_phase = now;
+    if (0 != last && now - last > PERIOD_MIN_NS && now - last < PERIOD_MAX_NS) {
+      track_period = (long) (now - last);
+      track_next = now + track_period;
+      track_locks++;
+    }
+    return;
+  }
+
+  err = now - track_next;
+  if (err > track_period / 4 || err < -(track_period / 4)) {
+    track_lost++;
+    track_period = 0;
+    track_phase = now;
+    return;
+  }
+  if ((err < 0 ? -err : err) > track_err_max) {
+    track_err_max = (long) (err < 0 ? -err : err);
+  }
+
+  track_phase = track_next + (err >> 2);
+  track_period += (long) (err >> 4);
+  track_next = track_phase + track_period;
+}
+
+/*
+  The pattern to display, and how many columns of it there are.
+ */
+typedef struct {
+  int count;
+  char pattern[PATTERN_SIZE];
+} PATTERN;
+
+/*
+  There are two patterns. The master task draws the 'front' one, while
+  the FIFO handler writes new ones into the 'back' one and then sets
+  'back_ready'. At the start of the next sweep the master task swaps
+  them, so a sweep never shows half of one pattern and half of
+  another, and the handler never has to wait for a sweep to finish.
+
+  The patterns are changed by patches, so after a swap the new back
+  one is missing the patches that went into the new front one. The
+  master task counts its swaps in 'swaps', and when the handler sees
+  there's been one, it copies the range of columns it changed since
+  the last one, 'dirty_lo' to 'dirty_hi', from front to back. This
+  costs as much as the changes did, not the whole pattern. Both
+  patterns start out the same.
+
+  The handler runs in Linux, which may be on another CPU from the
+  master task, at the same time. If the master task could see
+  'back_ready' set just as the handler clears it to start writing,
+  and then swap, the handler would go on writing into the front
+  pattern while it's drawn. So the master task's check-and-swap, and
+  the handler's taking of the back pattern and handing it over, are
+  each done holding the global RTAI lock, with interrupts off, which
+  makes each one step as far as the other can tell. Neither holds it
+  for more than a few stores.
+ */
+static PATTERN pattern_a = {4, {0xff, 0x00, 0xff, 0x00}};
+static PATTERN pattern_b = {4, {0xff, 0x00, 0xff, 0x00}};
+static int dirty_lo = PATTERN_SIZE;
+static int dirty_hi = 0;
+static int synced_swaps = 0;
+static int patch_count = 0;	/* how many patches */
+static int patch_bytes = 0;	/* how many bytes they had in all */
+
 struct data_ {
   int irq;
-  int count;
   int lpt_ctrl;
   long long t_diff;
   long long t_prev;
   long long t_short;
   long long t_long;
-  char pattern[1024];
-
-} d = {7, 4, 0, 0, 0, 0, 0, {0xff, 0x00, 0xff, 0x00}};
+  PATTERN * volatile front;
+  PATTERN * volatile back;
+  volatile int back_ready;
+  volatile int swaps;
+} d = {7, 0, 0, 0, 0, 0, &pattern_a, &pattern_b, 0, 0};
 
 RT_TASK master_task;
 
+/*
+  The LEDs are written through a PORT_REG, so that building with
+  PORTIO_TRACE records the column timing. See portio.h.
+ */
+static PORT_REG led_reg;
+
+/*
+  With PRECISE_COLUMNS set, each column is written at its exact time
+  by sleeping until just before it and spinning the rest of the way,
+  rather than by waiting for the next period, which puts it off by the
+  wakeup latency. See precise.h. The columns line up better, for
+  sharper characters. PRECISE_MARGIN_NS is how early to wake up to
+  start with, which adjusts itself from there.
+ */
+int PRECISE_COLUMNS = 1;
+module_param(PRECISE_COLUMNS, int, 0);
+
+int PRECISE_MARGIN_NS = 20000;
+module_param(PRECISE_MARGIN_NS, int, 0);
+
+static PRECISE column_precise;
+static RTIME column_next;
+static RTIME column_period;
+
+/* waits for the time to write the next column */
+static void column_wait(void)
+{
+  if (PRECISE_COLUMNS) {
+    precise_sleep_until(&column_precise, column_next);
+    column_next += column_period;
+  } else {
+    rt_task_wait_period();
+  }
+}
+
 static void disable_parport_int(void)
 {
   /* clear bit 4 of the parallel port control register, two bytes up
@@ -66,6 +220,9 @@ static void master_function(int arg)
 {
   int i, j, cnt, os, cyc;
   char *ptr;
+  char *pattern;
+  PATTERN *tmp;
+  unsigned long flags;
 
   os = 0;
 
@@ -74,10 +231,40 @@ static void master_function(int arg)
 
     /*
       Set the start time based on which tempo we're on, and use BASE_PER
-      as the inter-column period.
+      as the inter-column period, or if we're tracking the swing, scale
+      these to its period. The start delay is 34/80, or 17/40, of the
+      period, and the column period 1/7000 second per 80 milliseconds,
+      or 1/560 of the period. Periods are under 2^31 nanoseconds, so
+      we can do this without 64-bit division.
      */
-    rt_task_make_periodic(&master_task, nano2count(d.t_long + 34000000), nano2count(BASE_PER));
-    cnt = d.count;
+    if (TRACK_PHASE && 0 != track_period) {
+      column_next = nano2count(track_phase + (track_period / 40) * 17);
+      column_period = nano2count(track_period / 560);
+    } else {
+      column_next = nano2count(d.t_long + START_NOM_NS);
+      column_period = nano2count(BASE_PER);
+    }
+    if (! PRECISE_COLUMNS) {
+      rt_task_make_periodic(&master_task, column_next, column_period);
+    }
+    /*
+      If there's a new pattern, swap it to the front. The handler
+      doesn't touch the back one once it's set 'back_ready', and with
+      the lock it can't take it back between our check and the swap.
+     */
+    flags = rt_global_save_flags_and_cli();
+    if (d.back_ready) {
+      tmp = d.front;
+      d.front = d.back;
+      d.back = tmp;
+      d.back_ready = 0;
+      d.swaps++;
+      os = 0;
+    }
+    rt_global_restore_flags(flags);
+    pattern = d.front->pattern;
+
+    cnt = d.front->count;
     if (cnt > NCHARS * 8) {
       cyc = 1;
       os++;
@@ -88,67 +275,270 @@ static void master_function(int arg)
       cyc = 0;
       os = 0;
     }
-    ptr = &d.pattern[os];
+    ptr = &pattern[os];
 
     for (i = 0; i < NCHARS; i++) {
       for (j = 0; j < 16; j++) {
-	if (cyc && (ptr > &d.pattern[cnt])) {
-	  ptr = d.pattern;
+	if (cyc && (ptr > &pattern[cnt])) {
+	  ptr = pattern;
 	}
-	rt_task_wait_period();
+	column_wait();
 	if (j % 2) {
-	  outb(~*ptr++, PARPORT_BASE_ADDRESS);
+	  port_write(&led_reg, ~*ptr++);
 	} else {
-	  outb(0xff, PARPORT_BASE_ADDRESS);
+	  port_write(&led_reg, 0xff);
 	}
       }
     }
-    outb(0xff, PARPORT_BASE_ADDRESS);
+    port_write(&led_reg, 0xff);
   }
 
   return;
 }
 
+/*
+  dirty() notes that columns 'lo' up to 'hi' of the back pattern changed.
+ */
+static void dirty(int lo, int hi)
+{
+  if (lo < dirty_lo) dirty_lo = lo;
+  if (hi > dirty_hi) dirty_hi = hi;
+}
+
 int fifo_handler(unsigned int fifo)
 {
-  memset(d.pattern, 0, sizeof(d.pattern));
+  static char scratch[64];	/* for bytes that don't fit */
+  PATCH_HEADER patch;
+  PATTERN * back;
+  PATTERN * front;
+  unsigned long flags;
+  int fit, num, swaps;
+
+  /*
+    Say the back pattern isn't ready first, so the master task won't
+    swap it in while we're writing it, and see which one it is and
+    how many swaps there have been, all in one step.
+   */
+  flags = rt_global_save_flags_and_cli();
+  d.back_ready = 0;
+  back = d.back;
+  front = d.front;
+  swaps = d.swaps;
+  rt_global_restore_flags(flags);
+
+  /*
+    If the master task swapped since we were last here, bring the back
+    pattern up to date with the front one.
+   */
+  if (swaps != synced_swaps) {
+    if (dirty_hi > dirty_lo) {
+      memcpy(&back->pattern[dirty_lo], &front->pattern[dirty_lo],
+	     dirty_hi - dirty_lo);
+    }
+    back->count = front->count;
+    dirty_lo = PATTERN_SIZE;
+    dirty_hi = 0;
+    synced_swaps = swaps;
+  }
+
+  while (sizeof(patch) == rtf_get(fifo, &patch, sizeof(patch))) {
+    patch_count++;
+    if (patch.length < 0) patch.length = 0;
+    if (patch.offset < 0) patch.offset = 0;
+    else if (patch.offset > PATTERN_SIZE) patch.offset = PATTERN_SIZE;
+    if (patch.count < 0) patch.count = 0;
+    else if (patch.count > PATTERN_SIZE) patch.count = PATTERN_SIZE;
+
+    /*
+      Read the new bytes straight into place, and throw away any that
+      would go past the end.
+     */
+    fit = PATTERN_SIZE - patch.offset;
+    if (fit > patch.length) fit = patch.length;
+    if (fit > 0) {
+      num = rtf_get(fifo, &back->pattern[patch.offset], fit);
+      if (num > 0) {
+	dirty(patch.offset, patch.offset + num);
+	patch_bytes += num;
+      }
+    }
+    for (num = patch.length - fit; num > 0; num -= sizeof(scratch)) {
+      rtf_get(fifo, scratch, num < sizeof(scratch) ? num : sizeof(scratch));
+    }
+
+    /*
+      Clear anything past the new end, since the master task draws the
+      whole display even if the pattern is shorter.
+     */
+    if (patch.count < back->count) {
+      memset(&back->pattern[patch.count], 0, back->count - patch.count);
+      dirty(patch.count, back->count);
+    }
+    back->count = patch.count;
+  }
 
-  d.count = rtf_get(fifo, d.pattern, sizeof(d.pattern));
+  /*
+    Hand it over, once all the writes to it are done.
+   */
+  wmb();
+  flags = rt_global_save_flags_and_cli();
+  d.back_ready = 1;
+  rt_global_restore_flags(flags);
 
   return 0;
 }
 
 static int count = 0;
 
-static void slave_isr(void)
+/*
+  swing_pulse() handles a pulse from the sensor at time 'now', in
+  nanoseconds. It's called from the interrupt handler, or from the
+  simulated swing.
+ */
+static void swing_pulse(long long now)
 {
-  long long now;
-
-  disable_parport_int();
-
   count++;
 
   /* you get 2 pulse close together (42.5), the pattern repeats every
      80ms, this is used to get the direction of travel */
-  now = rt_get_time_ns();
   d.t_diff = now - d.t_prev;
   d.t_prev = now;
-  if (d.t_diff < 50000000LL) {
+  /*
+    Gaps shorter than 50 of the 80 milliseconds are the short ones,
+    scaled to the swing if we're tracking it.
+   */
+  if (d.t_diff < (TRACK_PHASE && 0 != track_period ?
+		  (track_period / 8) * 5 : 50000000LL)) {
     d.t_short = now;
   } else {
   d.t_long = now;
+  if (TRACK_PHASE) {
+    track_long_gap(now);
+  }
   rt_task_resume(&master_task);
   }
+}
+
+static void slave_isr(void)
+{
+  disable_parport_int();
+
+  swing_pulse(rt_get_time_ns());
 
   rt_startup_irq(PARPORT_IRQ);
   enable_parport_int();
 }
 
+/*
+  With SIM_PERIOD_NS set, there's no wand and no interrupt. Instead a
+  task makes up sensor pulses for a wand swinging with that period,
+  and notes in the port trace when the wand is at each end, so that
+  with 'make PORTIO_SIM=1 PORTIO_TRACE=1' the columns can be checked
+  without any hardware. 'wand_app' turns the trace into a picture of
+  what you'd see.
+
+  Each swing, the sensor pulses at the end of the long gap, and again
+  SIM_SHORT thousandths of the period later, ending the short gap.
+  The wand leaves the left end SIM_LEAD thousandths of the period
+  after the second pulse, and gets to the right end half a period
+  later. Drawing starts START_NOM_NS after the first pulse, so by
+  default, with SIM_LEAD -1, it's worked out from that and SIM_SHORT
+  to center the columns in the sweep, SIM_LEAD_CENTER less SIM_SHORT,
+  354 for the defaults.
+
+  SIM_CHIRP_NS is added to the period each swing, turning around at
+  the shortest and longest swings we'll track, to see how the tracking
+  keeps up. SIM_JITTER_NS moves each pulse by up to that much either
+  way, at random, like a real sensor.
+ */
+int SIM_PERIOD_NS = 0;
+module_param(SIM_PERIOD_NS, int, 0);
+
+int SIM_SHORT = 50;
+module_param(SIM_SHORT, int, 0);
+
+int SIM_LEAD = -1;
+module_param(SIM_LEAD, int, 0);
+
+/*
+  When the wand should leave the left end, in thousandths of the
+  period after the first pulse, for the columns to be centered: they
+  start START_NOM_NS in and take NCHARS * 16 column periods, and the
+  wand gets to the middle a quarter period after it leaves the left
+  end. The compiler works this out, so there's no floating point.
+ */
+#define SIM_LEAD_CENTER \
+  ((int) ((START_NOM_NS + NCHARS * 16 * BASE_PER / 2 - PERIOD_NOM_NS / 4) \
+	  * 1000 / PERIOD_NOM_NS + 0.5))
+
+int SIM_CHIRP_NS = 0;
+module_param(SIM_CHIRP_NS, int, 0);
+
+int SIM_JITTER_NS = 0;
+module_param(SIM_JITTER_NS, int, 0);
+
+RT_TASK sim_task;
+
+/* jitter() returns a random time between -SIM_JITTER_NS and SIM_JITTER_NS */
+static long jitter(void)
+{
+  static unsigned long seed = 1;
+
+  if (SIM_JITTER_NS <= 0) {
+    return 0;
+  }
+  seed = seed * 1103515245 + 12345;
+
+  return (long) ((seed >> 8) % (2 * SIM_JITTER_NS + 1)) - SIM_JITTER_NS;
+}
+
+/* sim_at() sleeps until 'ns', in nanoseconds */
+static void sim_at(long long ns)
+{
+  rt_sleep_until(nano2count(ns));
+}
+
+static void sim_function(int arg)
+{
+  long period = SIM_PERIOD_NS;
+  long chirp = SIM_CHIRP_NS;
+  int lead = (SIM_LEAD >= 0 ? SIM_LEAD : SIM_LEAD_CENTER - SIM_SHORT);
+  long long t;
+
+  /* start the first swing a period from now */
+  t = rt_get_time_ns() + period;
+
+  while (1) {
+    sim_at(t - (period / 1000) * SIM_SHORT + jitter());
+    portio_record(SIM_SENSOR_PORT, SIM_SENSOR_PULSE);
+    swing_pulse(rt_get_time_ns());
+
+    sim_at(t + jitter());
+    portio_record(SIM_SENSOR_PORT, SIM_SENSOR_PULSE);
+    swing_pulse(rt_get_time_ns());
+
+    sim_at(t + (period / 1000) * lead);
+    portio_record(SIM_END_PORT, SIM_END_LEFT);
+
+    sim_at(t + (period / 1000) * lead + period / 2);
+    portio_record(SIM_END_PORT, SIM_END_RIGHT);
+
+    t += period;
+    period += chirp;
+    if (period < PERIOD_MIN_NS || period > PERIOD_MAX_NS) {
+      chirp = -chirp;
+      period += 2 * chirp;
+    }
+  }
+
+  return;
+}
+
 int init_module(void)
 {
   int retval;
 
-  retval = rtf_create(0, 1024);
+  retval = rtf_create(0, PATCH_FIFO_SIZE);
   if (retval) {
     printk("can't create fifo\n");
     return retval;
@@ -161,18 +551,25 @@ int init_module(void)
     return retval;
   }
 
-  /* create irq handler */
-  rt_free_global_irq(PARPORT_IRQ);
-  retval = rt_request_global_irq(PARPORT_IRQ, slave_isr);
-  if (retval) {
-    printk("can't attach to IRQ\n");
-    return retval;
+  /* create irq handler, unless we're simulating the swing */
+  if (0 == SIM_PERIOD_NS) {
+    rt_free_global_irq(PARPORT_IRQ);
+    retval = rt_request_global_irq(PARPORT_IRQ, slave_isr);
+    if (retval) {
+      printk("can't attach to IRQ\n");
+      return retval;
+    }
+    rt_startup_irq(PARPORT_IRQ);
+    enable_parport_int();
   }
-  rt_startup_irq(PARPORT_IRQ);
-  enable_parport_int();
+
+  if (0 != portio_trace_init()) {
+    printk("can't allocate port trace\n");
+  }
+  port_init(&led_reg, PARPORT_BASE_ADDRESS);
 
   /* clear the leds */
-  outb(0xFF, PARPORT_BASE_ADDRESS);
+  port_write(&led_reg, 0xFF);
 
   retval = rt_task_init(&master_task, master_function, 0, 
 			3000, 10, 0, 0);
@@ -183,6 +580,8 @@ int init_module(void)
 
   rt_set_oneshot_mode();
   start_rt_timer(1);
+  /* after starting the timer, so counts are right */
+  precise_init(&column_precise, PRECISE_MARGIN_NS, 2000);
 
   retval = rt_task_make_periodic(&master_task, rt_get_time(), 1);
   if (retval) {
@@ -190,18 +589,43 @@ int init_module(void)
     return retval;
   }
 
+  if (0 != SIM_PERIOD_NS) {
+    /* higher priority than the master task, as an interrupt would be */
+    retval = rt_task_init(&sim_task, sim_function, 0, 3000, 5, 0, 0);
+    if (retval) {
+      printk("can't initialize sim task\n");
+      return retval;
+    }
+    rt_task_resume(&sim_task);
+    printk("simulating a %d nsec swing\n", SIM_PERIOD_NS);
+  }
+
   return 0;
 }
 
 void cleanup_module(void)
 {
+  if (0 != SIM_PERIOD_NS) {
+    rt_task_delete(&sim_task);
+  } else {
+    disable_parport_int();
+    rt_shutdown_irq(PARPORT_IRQ);
+    rt_free_global_irq(PARPORT_IRQ);
+  }
   rt_task_delete(&master_task);
-  disable_parport_int();
-  rt_shutdown_irq(PARPORT_IRQ);
-  rt_free_global_irq(PARPORT_IRQ);
   rtf_destroy(0);
+  portio_trace_exit();
 
   printk("count = %d\n", count);
+  if (PRECISE_COLUMNS) {
+    precise_report(&column_precise, "columns");
+  }
+  printk("%d patches, %d bytes\n", patch_count, patch_bytes);
+  if (TRACK_PHASE) {
+    printk("tracking: period %ld nsecs, locked %d times, lost %d times, "
+	   "largest error %ld nsecs\n",
+	   track_period, track_locks, track_lost, track_err_max);
+  }
 
   return;
 }
@@ -0,0 +1,321 @@
+/*
+  wand_app.c
+
+  Renders what the LED wand would show, from a port trace of the RT
+  task running a simulated swing, built and loaded with
+
+  make PORTIO_SIM=1 PORTIO_TRACE=1
+  insmod ledclock_task.ko SIM_PERIOD_NS=80000000
+
+  The trace has every column written to the LEDs, with the time, and
+  the times the simulated wand was at each end. In between, the wand
+  moves like a pendulum, fastest in the middle, so from the time of
+  each column we know where the wand was when it was lit. We add up
+  how long each LED was lit at each point across the swing, over all
+  the swings in the trace, and write that out as a grayscale image,
+  the way your eye would average it.
+
+  The module can be left running: we copy the trace out first, and
+  leave out any records it wrote over while we were copying.
+
+  Usage: wand_app [-p <port>] [-w <width>] [-z <zoom>] [-o <file>]
+                  [-r <reference> [-t <tolerance>]]
+
+  <port> is the LED port, by default 0x378. <width> is how many pixels
+  across the whole swing, by default 640, and each LED is <zoom>
+  pixels high, by default 8. The image goes to <file>, as a binary
+  PGM, or to standard output if there's no -o.
+
+  With -r, the image is also compared to the PGM in <reference>, e.g.
+  one saved before a change to the timing, and the average and worst
+  differences are printed, as gray levels out of 255. If the average
+  is more than <tolerance>, by default 2, we return 1, so this can be
+  used in scripts.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include <stdio.h>		/* printf(), fopen() */
+#include <stdlib.h>		/* malloc(), atoi(), atof(), strtol() */
+#include <string.h>		/* strcmp() */
+#include <math.h>		/* cos() */
+#include <sys/mman.h>		/* PROT_READ, needed for rtai_shm.h */
+#include <sys/types.h>		/* off_t, needed for rtai_shm.h */
+#include <sys/fcntl.h>		/* O_RDWR, needed for rtai_shm.h */
+#include <rtai_shm.h>		/* rtai_malloc,free() */
+#include "portio_trace.h"	/* PORTIO_LOG, PORTIO_RECORD */
+#include "common.h"		/* SIM_END_PORT, SIM_END_LEFT,RIGHT */
+
+#define LEDS 8
+#define STEP_NS 1000		/* how finely to follow the wand */
+
+/*
+  The times the wand was at each end, and which end, in time order.
+ */
+static double * end_ns;
+static int * end_side;
+static int ends = 0;
+
+/*
+  position() returns where the wand was at time 'ns', from 0 at the
+  left end to 1 at the right, or -1 if it's not between two ends we
+  know of. 'e' is where to start looking in the ends, and is moved up
+  as time goes on.
+ */
+static double position(double ns, int * e)
+{
+  double x;
+
+  while (*e + 1 < ends && end_ns[*e + 1] <= ns) {
+    (*e)++;
+  }
+  if (*e + 1 >= ends || ns < end_ns[*e]) {
+    return -1.0;
+  }
+
+  x = (1.0 - cos(M_PI * (ns - end_ns[*e]) / (end_ns[*e + 1] - end_ns[*e]))) / 2.0;
+
+  return end_side[*e] == SIM_END_LEFT ? x : 1.0 - x;
+}
+
+/*
+  compare() compares 'image' to the PGM in 'file', which must be the
+  same size. Returns the average difference, or -1 if it can't.
+ */
+static double compare(const unsigned char * image, int width, int height,
+		      const char * file)
+{
+  FILE * fp;
+  int w, h, max;
+  int c, worst = 0;
+  long i, n = (long) width * height;
+  double sum = 0.0;
+
+  if (NULL == (fp = fopen(file, "rb"))) {
+    fprintf(stderr, "can't open %s\n", file);
+    return -1.0;
+  }
+  if (3 != fscanf(fp, "P5 %d %d %d", &w, &h, &max) || 255 != max ||
+      w != width || h != height) {
+    fprintf(stderr, "%s isn't a %d by %d PGM\n", file, width, height);
+    fclose(fp);
+    return -1.0;
+  }
+  fgetc(fp);			/* the one whitespace after the header */
+  for (i = 0; i < n; i++) {
+    if (EOF == (c = fgetc(fp))) {
+      fprintf(stderr, "%s is too short\n", file);
+      fclose(fp);
+      return -1.0;
+    }
+    c = abs(c - image[i]);
+    sum += c;
+    if (c > worst) worst = c;
+  }
+  fclose(fp);
+
+  fprintf(stderr, "difference from %s: average %.3f, worst %d\n",
+	  file, sum / n, worst);
+
+  return sum / n;
+}
+
+int main(int argc, char * argv[])
+{
+  PORTIO_LOG * log;
+  PORTIO_RECORD * rec;
+  PORTIO_RECORD * trace;	/* our copy of the records */
+  unsigned int count, first, after, t;
+  int port = 0x378;
+  int width = 640;
+  int zoom = 8;
+  const char * out = NULL;
+  const char * ref = NULL;
+  double tolerance = 2.0;
+  double * lit;			/* how long each pixel was lit */
+  unsigned char * image;
+  double ns, next_ns, x, most;
+  int value, e, led, row, col, columns;
+  FILE * fp;
+  int retval = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      fprintf(stderr, "missing value for %s\n", argv[i]);
+      return 1;
+    } else if (! strcmp(argv[i], "-p")) {
+      port = strtol(argv[++i], NULL, 0);
+    } else if (! strcmp(argv[i], "-w")) {
+      width = atoi(argv[++i]);
+    } else if (! strcmp(argv[i], "-z")) {
+      zoom = atoi(argv[++i]);
+    } else if (! strcmp(argv[i], "-o")) {
+      out = argv[++i];
+    } else if (! strcmp(argv[i], "-r")) {
+      ref = argv[++i];
+    } else if (! strcmp(argv[i], "-t")) {
+      tolerance = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (width < 2 || zoom < 1) {
+    fprintf(stderr, "bad width or zoom\n");
+    return 1;
+  }
+
+  log = rtai_malloc(PORTIO_TRACE_KEY, sizeof(PORTIO_LOG));
+  if (0 == log) {
+    fprintf(stderr, "can't allocate shared memory\n");
+    return 1;
+  }
+  if (log->magic != PORTIO_TRACE_MAGIC ||
+      log->version != PORTIO_TRACE_VERSION ||
+      log->size != PORTIO_TRACE_LEN ||
+      log->bytes != sizeof(PORTIO_LOG)) {
+    fprintf(stderr, "no port trace, or its layout doesn't match; "
+	    "load ledclock_task built with PORTIO_TRACE=1\n");
+    rtai_free(PORTIO_TRACE_KEY, log);
+    return 1;
+  }
+
+  /*
+    The module may still be recording, and if it goes around the ring
+    while we read it, the oldest records will change under us, and a
+    lost swing end would throw off where the wand was. So we copy the
+    records out, then see how far the module got while we did, and
+    leave out any that it may have written over. The one at 'after -
+    PORTIO_TRACE_LEN' may have been half written.
+   */
+  count = log->count;
+  first = (count > PORTIO_TRACE_LEN ? count - PORTIO_TRACE_LEN : 0);
+  trace = malloc((count - first + 1) * sizeof(*trace));
+  if (NULL == trace) {
+    fprintf(stderr, "out of memory\n");
+    rtai_free(PORTIO_TRACE_KEY, log);
+    return 1;
+  }
+  for (t = first; t < count; t++) {
+    trace[t - first] = log->record[t % PORTIO_TRACE_LEN];
+  }
+  __asm__ __volatile__ ("" : : : "memory"); /* copy, then look again */
+  after = log->count;
+  if (after >= PORTIO_TRACE_LEN && after - PORTIO_TRACE_LEN + 1 > first) {
+    t = after - PORTIO_TRACE_LEN + 1;
+    if (t > count) t = count;
+    memmove(trace, &trace[t - first], (count - t) * sizeof(*trace));
+    fprintf(stderr, "the trace moved on while we read it, "
+	    "leaving out %u records\n", t - first);
+    first = t;
+  }
+
+  /*
+    First pick out the ends of the swings.
+   */
+  end_ns = malloc((count - first + 1) * sizeof(*end_ns));
+  end_side = malloc((count - first + 1) * sizeof(*end_side));
+  lit = calloc(LEDS * width, sizeof(*lit));
+  image = malloc(LEDS * zoom * width);
+  if (NULL == end_ns || NULL == end_side || NULL == lit || NULL == image) {
+    fprintf(stderr, "out of memory\n");
+    rtai_free(PORTIO_TRACE_KEY, log);
+    return 1;
+  }
+  for (t = first; t < count; t++) {
+    rec = &trace[t - first];
+    if (SIM_END_PORT == rec->port) {
+      end_ns[ends] = rec->ns;
+      end_side[ends] = rec->value;
+      ends++;
+    }
+  }
+  if (ends < 2) {
+    fprintf(stderr, "no simulated swings in the trace; "
+	    "load ledclock_task with SIM_PERIOD_NS set\n");
+    rtai_free(PORTIO_TRACE_KEY, log);
+    return 1;
+  }
+
+  /*
+    Then go through the LED writes, following the wand from each one
+    to the next in steps of STEP_NS, and add up where each LED was lit.
+    The LEDs are on when their bits are 0, with the top one in the top
+    bit.
+   */
+  e = 0;
+  value = -1;
+  ns = 0.0;
+  columns = 0;
+  for (t = first; t < count; t++) {
+    rec = &trace[t - first];
+    if (rec->port != port) {
+      continue;
+    }
+    next_ns = rec->ns;
+    if (-1 != value && 0xFF != value) {
+      for (; ns < next_ns; ns += STEP_NS) {
+	if ((x = position(ns, &e)) < 0.0) {
+	  continue;
+	}
+	col = (int) (x * (width - 1) + 0.5);
+	for (led = 0; led < LEDS; led++) {
+	  if (! (value & (0x80 >> led))) {
+	    lit[led * width + col] += STEP_NS;
+	  }
+	}
+      }
+    }
+    ns = next_ns;
+    value = rec->value;
+    columns++;
+  }
+
+  /*
+    Scale the brightest pixel to white, and draw each LED 'zoom' rows
+    high, with a dark row between them if there's room.
+   */
+  most = 0.0;
+  for (i = 0; i < LEDS * width; i++) {
+    if (lit[i] > most) most = lit[i];
+  }
+  for (row = 0; row < LEDS * zoom; row++) {
+    led = row / zoom;
+    for (col = 0; col < width; col++) {
+      if (zoom > 2 && zoom - 1 == row % zoom) {
+	image[row * width + col] = 0;
+      } else {
+	image[row * width + col] =
+	  (most > 0.0 ? (int) (255.0 * lit[led * width + col] / most + 0.5) : 0);
+      }
+    }
+  }
+
+  fp = (NULL == out ? stdout : fopen(out, "wb"));
+  if (NULL == fp) {
+    fprintf(stderr, "can't open %s\n", out);
+    retval = 1;
+  } else {
+    fprintf(fp, "P5\n%d %d\n255\n", width, LEDS * zoom);
+    fwrite(image, 1, LEDS * zoom * width, fp);
+    if (NULL != out) fclose(fp);
+  }
+  fprintf(stderr, "%u records, %d swing ends, %d LED writes\n",
+	  count - first, ends, columns);
+
+  if (NULL != ref) {
+    x = compare(image, width, LEDS * zoom, ref);
+    if (x < 0.0 || x > tolerance) {
+      retval = 1;
+    }
+  }
+
+  free(trace);
+  rtai_free(PORTIO_TRACE_KEY, log);
+
+  return retval;
+}
@@ -2,7 +2,9 @@
   stack_task.c
 
   Shows how to determine the stack size for a task, using our own 
-  functions rt_task_stack_init() and rt_task_stack_check().
+  functions rt_task_stack_init() and rt_task_stack_check(), which are
+  in stackmon.c along with a monitor that uses them to watch the
+  stacks of all our tasks as they run.
 
   The stack size for a task is the space needed for its arguments, its
   stack variables, and all the variables encountered through the
@@ -113,6 +115,7 @@
 #include <linux/sched.h>
 #include "rtai.h"
 #include "rtai_sched.h"
+#include "stackmon.h"		/* rt_task_stack_init,check(), stack_task_init() */
 
 /*
   Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
@@ -138,9 +141,43 @@ MODULE_LICENSE("GPL");
 #endif
 
 static RT_TASK stack_task;
+static STACK_TASK stack_watch;
 static int stack_task_inited;
 #define STACKSIZE 1024
-static int pattern = 0xDEADBEEF;
+static int pattern = STACK_PATTERN;
+
+/*
+  The stack monitor in stackmon.c watches all the tasks made with
+  stack_task_init() while they run, checking every STACK_CHECK_MS
+  milliseconds and warning when one has fewer than STACK_WARN_BYTES
+  left. To show it at work, 'deep_task' goes one call deeper each
+  period, so its headroom shrinks as it runs, until it has less than
+  STACK_WARN_BYTES left, which the monitor should warn about. It
+  checks its own stack each time, the slow sure way, so it stops a
+  call or so past the line, well short of running out, whatever size
+  the compiler makes its frames. DEEP_MAX is a limit on the calls in
+  case the stack check doesn't work.
+ */
+int STACK_CHECK_MS = 100;
+module_param(STACK_CHECK_MS, int, 0);
+
+int STACK_WARN_BYTES = 512;
+module_param(STACK_WARN_BYTES, int, 0);
+
+int DEEP_MAX = 64;
+module_param(DEEP_MAX, int, 0);
+
+/*
+  With STACK_SELFTEST set, we first check that the monitor's quick
+  scan, stack_scan(), gives the same answers as the plain one.
+ */
+int STACK_SELFTEST = 1;
+module_param(STACK_SELFTEST, int, 0);
+
+static RT_TASK deep_task;
+static STACK_TASK deep_watch;
+static int deep_task_inited;
+#define DEEP_STACKSIZE 2048
 
 /* macro for getting the number of array elements of an array */
 #define numof(a) (sizeof(a)/sizeof(a[0]))
@@ -197,46 +234,52 @@ static void task_code(int arg)
 }
 
 /*
-  Initialize the stack with a recognizable pattern, one that will
-  be looked for in rt_task_stack_check() to see how much was actually
-  used.
+  deeper() calls itself 'depth' times, using some stack each time.
+
+  The compiler is good at making this sort of thing take no stack at
+  all. If 'data' were a plain array, it would see that only the sum
+  is needed and drop the array, and then turn the calls into a loop,
+  leaving a frame of a few bytes and no calls. So 'data' is volatile,
+  which makes it keep the array on the stack; it's added up after the
+  call, so the call can't be turned into a jump; and deeper() is kept
+  from being inlined into deep_code(). Then each call really takes a
+  frame of about 80 bytes, as 'make stackcheck' shows.
  */
-int rt_task_stack_init(RT_TASK * task, int pattern)
+static int __attribute__ ((noinline)) deeper(int depth)
 {
-  long int * ptr;
+  volatile int data[16];
+  int t;
+  int val;
 
-  /*
-    Clobber the stack with a recognizable pattern. The bottom,
-    task->stack_bottom, is writeable. The top, task->stack,
-    points to some RTAI data and can't be written.
-  */
-  for (ptr = task->stack_bottom; ptr < task->stack; ptr++) {
-    *ptr = pattern;
+  for (t = 0; t < numof(data); t++) {
+    data[t] = depth + t;
+  }
+  val = 0;
+  if (depth > 0) {
+    val = deeper(depth - 1);
+  }
+  for (t = 0; t < numof(data); t++) {
+    val += data[t];
   }
 
-  return 0;
+  return val;
 }
 
-/*
-  Check the stack and see how much was used by comparing what's left
-  with the initialization pattern.
- */
-int rt_task_stack_check(RT_TASK * task, int pattern)
+static void deep_code(int arg)
 {
-  long int * ptr;
-  int unused;
+  int depth = 0;
+  int val = 1;
 
-  /*
-    Read up from the bottom and count the unused bytes.
-  */
-  for (unused = 0, ptr = task->stack_bottom; ptr < task->stack; ptr++) {
-    if (*ptr != pattern) {
-      break;
+  while (val) {
+    val = deeper(depth);
+    if (depth < DEEP_MAX &&
+	rt_task_stack_check(&deep_task, pattern) >= STACK_WARN_BYTES) {
+      depth++;
     }
-    unused += sizeof(int);
+    rt_task_wait_period();
   }
 
-  return unused;
+  return;
 }
 
 int init_module(void)
@@ -247,18 +290,37 @@ int init_module(void)
   RTIME task_period;
   int retval;
 
+  if (STACK_SELFTEST) {
+    retval = stack_scan_selftest();
+    printk("stack scan self-test: %s, %d disagreements\n",
+	   retval ? "FAILED" : "passed", retval);
+  }
+
+  /*
+    Make the task, initializing the stack with a recognizable pattern,
+    and have the monitor watch it.
+   */
   stack_task_inited = 0;
-  retval = rt_task_init(&stack_task, task_code, 0,
-			STACKSIZE,
-			RT_LOWEST_PRIORITY, 0, 0);
+  retval = stack_task_init(&stack_watch, "stack_task",
+			   &stack_task, task_code, 0,
+			   STACKSIZE,
+			   RT_LOWEST_PRIORITY - 1, 0, 0);
   if (retval) {
     printk("could not init task\n");
     return retval;
   }
   stack_task_inited = 1;
 
-  /* initialize the stack with a recognizable pattern */
-  rt_task_stack_init(&stack_task, pattern);
+  deep_task_inited = 0;
+  retval = stack_task_init(&deep_watch, "deep_task",
+			   &deep_task, deep_code, 0,
+			   DEEP_STACKSIZE,
+			   RT_LOWEST_PRIORITY - 1, 0, 0);
+  if (retval) {
+    printk("could not init deep task\n");
+    return retval;
+  }
+  deep_task_inited = 1;
 
   /* run our trivial task in one-shot mode at 1 millisecond intervals */
   rt_set_oneshot_mode();
@@ -272,6 +334,24 @@ int init_module(void)
     return 0;
   }
 
+  retval = rt_task_make_periodic(&deep_task,
+				 rt_get_time() + task_period,
+				 nano2count(STACK_CHECK_MS * 1000000LL) / 2);
+  if (retval) {
+    printk("could not start deep task\n");
+    return 0;
+  }
+
+  /*
+    The monitor runs below both of them. If it can't be started, the
+    tasks are fine without it, so we carry on, but there will be no
+    warnings while they run, only the report when we're unloaded.
+   */
+  retval = stackmon_start(STACK_CHECK_MS * 1000000LL, STACK_WARN_BYTES);
+  if (retval) {
+    printk("stack monitor not running, stacks checked only on unload\n");
+  }
+
   return 0;
 }
 
@@ -279,6 +359,8 @@ void cleanup_module(void)
 {
   long int * ptr;
 
+  stackmon_stop();
+
   if (stack_task_inited) {
     rt_task_suspend(&stack_task);
 
@@ -294,10 +376,23 @@ void cleanup_module(void)
      */
     printk("%d unused stack bytes\n", 
 	   rt_task_stack_check(&stack_task, pattern));
+  }
+
+  if (deep_task_inited) {
+    rt_task_suspend(&deep_task);
+  }
 
-    rt_task_delete(&stack_task);
+  /* the headroom of everything the monitor watched */
+  stackmon_report();
+
+  if (stack_task_inited) {
+    stack_task_delete(&stack_watch);
     stack_task_inited = 0;
   }
+  if (deep_task_inited) {
+    stack_task_delete(&deep_watch);
+    deep_task_inited = 0;
+  }
 
   stop_rt_timer();
   
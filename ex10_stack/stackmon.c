@@ -0,0 +1,429 @@
+/*
+  stackmon.c
+
+  Watching the stacks of RTAI tasks as they run, so we can find out how
+  close to running out they really get, rather than checking one task
+  once when it's unloaded.
+
+  The checking is the one shown in stack_task.c: paint the stack with a
+  pattern when the task is made, before it's run, and count how much
+  of the pattern is left at the bottom. Since the stack only ever
+  eats into the pattern, the count only goes down, so checking it now
+  and then from a low-priority task tells us the least headroom so far
+  without slowing down the tasks being watched.
+
+  The monitor runs at the lowest priority, so it only checks when
+  nothing else has anything to do. Warnings are printed with
+  rt_printk(), which is safe to call from RT tasks. Each task is
+  warned about again only when its headroom has gone down by another
+  STACKMON_WARN_STEP bytes, so a task sitting near the line doesn't
+  flood the log.
+*/
+
+#include <linux/kernel.h>
+#include <linux/errno.h>	/* ENOSPC */
+#include "rtai.h"
+#include "rtai_sched.h"
+#include "stackmon.h"
+
+/*
+  Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
+  get that if necessary
+ */
+#if ! defined(RT_LOWEST_PRIORITY)
+#if defined(RT_SCHED_LOWEST_PRIORITY)
+#define RT_LOWEST_PRIORITY RT_SCHED_LOWEST_PRIORITY
+#else
+#error RT_SCHED_LOWEST_PRIORITY not defined
+#endif
+#endif
+
+#define STACKMON_WARN_STEP 64
+
+static STACK_TASK * watched[STACKMON_MAX_TASKS] = {0};
+
+static RT_TASK monitor_task;
+static int monitor_inited = 0;
+static int monitor_warn_bytes = 0;
+
+/*
+  Initialize the stack with a recognizable pattern, one that will
+  be looked for in rt_task_stack_check() to see how much was actually
+  used.
+ */
+int rt_task_stack_init(RT_TASK * task, int pattern)
+{
+  long int * ptr;
+
+  /*
+    Clobber the stack with a recognizable pattern. The bottom,
+    task->stack_bottom, is writeable. The top, task->stack,
+    points to some RTAI data and can't be written.
+  */
+  for (ptr = task->stack_bottom; ptr < task->stack; ptr++) {
+    *ptr = pattern;
+  }
+
+  return 0;
+}
+
+/*
+  Check the stack and see how much was used by comparing what's left
+  with the initialization pattern.
+ */
+static int linear_check(long int * bottom, long int * top, int pattern)
+{
+  long int * ptr;
+  int unused;
+
+  /*
+    Read up from the bottom and count the unused bytes.
+  */
+  for (unused = 0, ptr = bottom; ptr < top; ptr++) {
+    if (*ptr != pattern) {
+      break;
+    }
+    unused += sizeof(long int);
+  }
+
+  return unused;
+}
+
+int rt_task_stack_check(RT_TASK * task, int pattern)
+{
+  return linear_check(task->stack_bottom, task->stack, pattern);
+}
+
+/*
+  scan() is stack_scan() for the 'words' words at 'bottom'. See
+  stackmon.h for how it works.
+ */
+static int scan(STACK_SCAN * s, long int * bottom, int words, int pattern,
+		int budget)
+{
+  int lo, hi, mid;
+
+  /* keep one read for the sweep, so it always gets somewhere */
+  if (budget < 2) budget = 2;
+  budget--;
+
+  /*
+    If the word just below the mark has been used, the stack has grown.
+    Step down until we find the pattern, moving the mark as we go, so
+    it's right as far as it goes if we run out of reads.
+   */
+  if (s->mark > 0) {
+    budget--;
+    s->reads++;
+    if (bottom[s->mark - 1] != pattern) {
+      s->mark--;
+      lo = -1;
+      while (s->mark > 0 && budget > 0) {
+	lo = (s->mark > STACK_SCAN_STRIDE ? s->mark - STACK_SCAN_STRIDE : 0);
+	budget--;
+	s->reads++;
+	if (bottom[lo] == pattern) {
+	  break;
+	}
+	s->mark = lo;
+	lo = -1;
+      }
+
+      /*
+	If we found the pattern at 'lo', the stack starts somewhere
+	above it and at or below the mark, so split the difference
+	until we know where.
+       */
+      if (lo >= 0) {
+	hi = s->mark;
+	while (hi - lo > 1 && budget > 0) {
+	  mid = lo + (hi - lo) / 2;
+	  budget--;
+	  s->reads++;
+	  if (bottom[mid] == pattern) {
+	    lo = mid;
+	  } else {
+	    hi = mid;
+	  }
+	}
+	s->mark = hi;
+      }
+    }
+  }
+
+  /*
+    Spend the rest on the sweep. Everything below the sweep was the
+    pattern, so if we find a used word it's the new mark, and the
+    sweep is done.
+   */
+  budget++;
+  while (budget > 0) {
+    if (s->sweep >= s->mark) {
+      s->sweep = 0;
+      s->sweeps++;
+      break;
+    }
+    budget--;
+    s->reads++;
+    if (bottom[s->sweep] != pattern) {
+      s->mark = s->sweep;
+    } else {
+      s->sweep++;
+    }
+  }
+
+  return s->mark * sizeof(long int);
+}
+
+void stack_scan_init(STACK_SCAN * s, RT_TASK * task)
+{
+  s->mark = task->stack - task->stack_bottom;
+  s->sweep = 0;
+  s->sweeps = 0;
+  s->reads = 0;
+}
+
+int stack_scan(STACK_SCAN * s, RT_TASK * task, int pattern, int budget)
+{
+  return scan(s, task->stack_bottom, task->stack - task->stack_bottom,
+	      pattern, budget);
+}
+
+/*
+  The self-test makes up stacks that have been used down to some
+  point, with some of the pattern left in the used part, and scans
+  them with a small budget, checking that the scan never says there's
+  more used than the plain scan does, and that once it's swept the
+  whole way since the last change, it says the same. Then it uses
+  more of the stack, and checks again.
+ */
+#define SELFTEST_WORDS 512
+#define SELFTEST_STACKS 50
+
+static long int selftest_stack[SELFTEST_WORDS];
+static unsigned long selftest_seed = 1;
+
+static int selftest_random(int n)
+{
+  selftest_seed = selftest_seed * 1103515245 + 12345;
+
+  return (selftest_seed >> 8) % n;
+}
+
+/*
+  use() writes over the stack from 'top' words down to 'lo', leaving
+  about one word in 'holes' as the pattern.
+ */
+static void use(int lo, int top, int holes, int pattern)
+{
+  int t;
+
+  for (t = lo; t < top; t++) {
+    if (holes > 0 && 0 == selftest_random(holes) && t != lo) {
+      selftest_stack[t] = pattern;
+    } else {
+      selftest_stack[t] = t;
+    }
+  }
+}
+
+/*
+  agree() scans until two sweeps are done, so one started after the
+  last change, checking as it goes. Returns 0 if all was well.
+ */
+static int agree(STACK_SCAN * s, int pattern, int budget)
+{
+  unsigned long sweeps = s->sweeps + 2;
+  int linear, scanned = 0;
+
+  linear = linear_check(selftest_stack, selftest_stack + SELFTEST_WORDS,
+			pattern);
+  while (s->sweeps < sweeps) {
+    scanned = scan(s, selftest_stack, SELFTEST_WORDS, pattern, budget);
+    if (scanned < linear) {
+      return 1;
+    }
+  }
+
+  return scanned != linear;
+}
+
+int stack_scan_selftest(void)
+{
+  STACK_SCAN s;
+  int pattern = STACK_PATTERN;
+  int failures = 0;
+  int top, lo, holes, budget;
+  int t;
+
+  for (t = 0; t < SELFTEST_STACKS; t++) {
+    for (top = 0; top < SELFTEST_WORDS; top++) {
+      selftest_stack[top] = pattern;
+    }
+    s.mark = SELFTEST_WORDS;
+    s.sweep = 0;
+    s.sweeps = 0;
+    s.reads = 0;
+    budget = 1 + selftest_random(STACKMON_BUDGET);
+    holes = (t % 3 ? 0 : 2 + selftest_random(8));
+
+    /* the fresh stack, then deeper and deeper */
+    failures += agree(&s, pattern, budget);
+    top = SELFTEST_WORDS;
+    while (top > 0) {
+      lo = top - 1 - selftest_random(t % 2 ? 4 : 64);
+      if (lo < 0) lo = 0;
+      use(lo, top, holes, pattern);
+      failures += agree(&s, pattern, budget);
+      top = lo;
+    }
+  }
+
+  return failures;
+}
+
+int stack_task_init(STACK_TASK * st, const char * name,
+		    RT_TASK * task, void (*rt_thread)(int), int data,
+		    int stack_size, int priority, int uses_fpu,
+		    void (*signal)(void))
+{
+  int retval;
+  int t;
+
+  st->name = name;
+  st->task = task;
+
+  retval = rt_task_init(task, rt_thread, data, stack_size, priority,
+			uses_fpu, signal);
+  if (retval) {
+    return retval;
+  }
+
+  /* the task hasn't run yet, so its stack is all ours to paint */
+  rt_task_stack_init(task, STACK_PATTERN);
+  stack_scan_init(&st->scan, task);
+  st->size = (task->stack - task->stack_bottom) * sizeof(long int);
+  st->headroom = st->size;
+  st->warned = st->size;
+  st->checks = 0;
+
+  for (t = 0; t < STACKMON_MAX_TASKS; t++) {
+    if (0 == watched[t]) {
+      watched[t] = st;
+      return 0;
+    }
+  }
+
+  printk("stackmon: no room to watch %s\n", name);
+  return -ENOSPC;
+}
+
+void stack_task_delete(STACK_TASK * st)
+{
+  int t;
+
+  for (t = 0; t < STACKMON_MAX_TASKS; t++) {
+    if (st == watched[t]) {
+      watched[t] = 0;
+    }
+  }
+  rt_task_delete(st->task);
+}
+
+/*
+  check() updates the headroom of 'st', and warns if it's too little.
+ */
+static void check(STACK_TASK * st)
+{
+  int unused;
+
+  unused = stack_scan(&st->scan, st->task, STACK_PATTERN, STACKMON_BUDGET);
+  st->checks++;
+  if (unused < st->headroom) {
+    st->headroom = unused;
+  }
+  if (st->headroom < monitor_warn_bytes &&
+      st->headroom + STACKMON_WARN_STEP <= st->warned) {
+    rt_printk("stackmon: %s has %d of %d stack bytes left%s\n",
+	      st->name, st->headroom, st->size,
+	      0 == st->headroom ? ", and may have overflowed" : "");
+    st->warned = st->headroom;
+  }
+}
+
+static void monitor_code(int arg)
+{
+  STACK_TASK * st;
+  int t;
+
+  while (1) {
+    for (t = 0; t < STACKMON_MAX_TASKS; t++) {
+      /* take a copy, in case it's unregistered while we look */
+      if (0 != (st = watched[t])) {
+	check(st);
+      }
+    }
+    rt_task_wait_period();
+  }
+
+  return;
+}
+
+int stackmon_start(RTIME period_ns, int warn_bytes)
+{
+  RTIME period;
+  int retval;
+
+  monitor_warn_bytes = warn_bytes;
+
+  retval = rt_task_init(&monitor_task, monitor_code, 0, 1024,
+			RT_LOWEST_PRIORITY, 0, 0);
+  if (retval) {
+    printk("stackmon: can't initialize monitor task\n");
+    return retval;
+  }
+  monitor_inited = 1;
+
+  period = nano2count(period_ns);
+  retval = rt_task_make_periodic(&monitor_task, rt_get_time() + period,
+				 period);
+  if (retval) {
+    printk("stackmon: can't start monitor task\n");
+    return retval;
+  }
+
+  return 0;
+}
+
+void stackmon_stop(void)
+{
+  if (monitor_inited) {
+    rt_task_delete(&monitor_task);
+    monitor_inited = 0;
+  }
+}
+
+void stackmon_report(void)
+{
+  STACK_TASK * st;
+  int linear;
+  int t;
+
+  for (t = 0; t < STACKMON_MAX_TASKS; t++) {
+    if (0 != (st = watched[t])) {
+      /* once more, the slow way, to be sure */
+      check(st);
+      linear = rt_task_stack_check(st->task, STACK_PATTERN);
+      if (linear < st->headroom) {
+	st->headroom = linear;
+      }
+      printk("stackmon: %s used %d of %d stack bytes, %d left, %d checks\n",
+	     st->name, st->size - st->headroom, st->size, st->headroom,
+	     st->checks);
+      printk("stackmon: %s scans read %lu words, %s the full check\n",
+	     st->name, st->scan.reads,
+	     st->scan.mark * (int) sizeof(long int) == linear ?
+	     "agreeing with" : "still catching up to");
+    }
+  }
+}
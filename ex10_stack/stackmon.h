@@ -0,0 +1,112 @@
+#ifndef STACKMON_H
+#define STACKMON_H
+
+/*
+  stackmon.h
+
+  Declarations for watching the stacks of RTAI tasks as they run. Each
+  task gets a STACK_TASK that's registered when the task is made, at
+  which time its stack is painted with STACK_PATTERN. A low-priority
+  monitor task then checks how much of the pattern is left in each
+  registered stack every so often, and warns when a task's headroom,
+  the stack it has never used, falls below a threshold.
+ */
+
+#include "rtai.h"
+#include "rtai_sched.h"		/* RT_TASK, RTIME */
+
+#define STACK_PATTERN 0xDEADBEEF
+
+enum {STACKMON_MAX_TASKS = 16, STACKMON_BUDGET = 32};
+
+/*
+  A STACK_SCAN finds the unused part of a stack a little at a time,
+  reading at most a given number of words each call, however big the
+  stack is. 'mark' is the lowest word, counting up from the bottom,
+  known to have been used, so the words below it are the headroom as
+  far as we know.
+
+  Stacks grow down, so each call first looks just below the mark, and
+  if the stack has grown, steps down STACK_SCAN_STRIDE words at a time
+  until it finds the pattern again and then homes in on where it
+  starts. That's a few reads instead of one for every unused word.
+  But the pattern can be left in places the stack has been, e.g., in
+  parts of an array that were never written, which would fool the
+  homing in, so whatever's left of the reads goes to a sweep up from
+  the bottom to the mark that checks every word. Once a sweep that
+  started after the stack last changed is done, the mark is exactly
+  what rt_task_stack_check() would say.
+ */
+#define STACK_SCAN_STRIDE 16
+
+typedef struct {
+  int mark;			/* lowest word known to be used */
+  int sweep;			/* how far up the sweep has got */
+  unsigned long sweeps;		/* how many sweeps have been done */
+  unsigned long reads;		/* how many words have been read */
+} STACK_SCAN;
+
+typedef struct {
+  const char * name;		/* for messages */
+  RT_TASK * task;		/* the task being watched */
+  int size;			/* bytes of stack we can use */
+  int headroom;			/* fewest unused bytes seen */
+  int warned;			/* headroom when we last warned, or 'size' */
+  int checks;			/* how many times it was checked */
+  STACK_SCAN scan;		/* how far the monitor has got */
+} STACK_TASK;
+
+/*
+  rt_task_stack_init() paints the stack of 'task' with 'pattern', and
+  rt_task_stack_check() returns how many bytes at the bottom still
+  have it, the part that's never been used.
+ */
+extern int rt_task_stack_init(RT_TASK * task, int pattern);
+extern int rt_task_stack_check(RT_TASK * task, int pattern);
+
+/*
+  stack_scan_init() starts 's' off for 'task', whose stack has just
+  been painted. stack_scan() reads at most 'budget' words of it, at
+  least 2, and returns how many bytes at the bottom are unused as far
+  as it knows now. It never says less than rt_task_stack_check() would.
+ */
+extern void stack_scan_init(STACK_SCAN * s, RT_TASK * task);
+extern int stack_scan(STACK_SCAN * s, RT_TASK * task, int pattern,
+		      int budget);
+
+/*
+  stack_scan_selftest() checks stack_scan() against a plain scan, on
+  made-up stacks. Returns how many times they didn't agree.
+ */
+extern int stack_scan_selftest(void);
+
+/*
+  stack_task_init() makes the task with rt_task_init(), taking the
+  same arguments plus 'st' and 'name', paints its stack and registers
+  it. Returns what rt_task_init() did, or -ENOSPC if there are too
+  many tasks, in which case the task is made but not watched.
+  stack_task_delete() unregisters it and deletes the task.
+ */
+extern int stack_task_init(STACK_TASK * st, const char * name,
+			   RT_TASK * task, void (*rt_thread)(int), int data,
+			   int stack_size, int priority, int uses_fpu,
+			   void (*signal)(void));
+extern void stack_task_delete(STACK_TASK * st);
+
+/*
+  stackmon_start() starts the monitor task, which checks every
+  'period_ns' nanoseconds, reading at most STACKMON_BUDGET words of
+  each stack each time, and warns when any task has fewer than
+  'warn_bytes' of headroom. Start the timer first. Returns 0 if OK,
+  else what rt_task_init() or rt_task_make_periodic() returned.
+  stackmon_stop() stops it.
+ */
+extern int stackmon_start(RTIME period_ns, int warn_bytes);
+extern void stackmon_stop(void);
+
+/*
+  stackmon_report() prints the headroom of all the registered tasks.
+ */
+extern void stackmon_report(void);
+
+#endif /* STACKMON_H */
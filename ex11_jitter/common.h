@@ -1,6 +1,9 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include "tsc.h"		/* TSC */
+#include "shm_header.h"		/* SHM_HEADER */
+
 /*
   Those who share the memory must agree to a unique key to identify it
   among the pool of shared memory used by everyone else. Pick an used
@@ -11,10 +14,27 @@ enum {SHM_KEY = 101};
 
 /*
   How many data elements are to be allocated for our array of TSC structs.
-  The actual space we will allocate will be SHM_HOWMANY * sizeof(TSC).
  */
 enum {SHM_HOWMANY = 1024};
 
+/*
+  The shared memory holds a header, followed by the log of TSCs. The
+  header, from shm_header.h in the top-level directory, lets the reader
+  check that it agrees with the RT task on the layout, so the log can
+  be made bigger without silently reading past the end. If the layout
+  changes, bump JITTER_VERSION.
+
+  The RT task sets 'ready' when the log is full, so the reader can
+  just wait for that rather than inspecting the data.
+ */
+enum {JITTER_MAGIC = 0x4A495430}; /* "JIT0" */
+enum {JITTER_VERSION = 1};
+
+typedef struct {
+  SHM_HEADER header;		/* JITTER_MAGIC, JITTER_VERSION, sizeof(JITTER_LOG) */
+  TSC tsc[SHM_HOWMANY];
+} JITTER_LOG;
+
 /*
   The nominal period for the jitter task, in nanoseconds
  */
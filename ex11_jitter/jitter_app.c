@@ -3,6 +3,12 @@
 
   Reads shared memory for a log of time stamp counts, differences them
   and converts to microseconds, and dumps them to a file for later plotting.
+
+  The shared memory is prefaulted and locked before we start polling it,
+  so that first touches of its pages don't add page fault time to our
+  reads. If the environment variable SHM_HUGE is set, we ask for huge
+  pages as well. Page fault counts are printed to stderr, so they don't
+  get mixed in with the data.
  */
 
 /*
@@ -11,52 +17,77 @@
 */
 
 #include <stdio.h>		/* printf() */
+#include <stdlib.h>		/* getenv() */
 #include <stddef.h>		/* sizeof() */
+#include <unistd.h>		/* usleep() */
 #include <sys/mman.h>		/* PROT_READ, needed for rtai_shm.h */
 #include <sys/types.h>		/* off_t, needed for rtai_shm.h */
 #include <sys/fcntl.h>		/* O_RDWR, needed for rtai_shm.h */
 #include <rtai_shm.h>		/* rtai_malloc,free() */
-#include "common.h"		/* SHM_KEY, SHM_HOWMANY */
+#include "common.h"		/* SHM_KEY, SHM_HOWMANY, JITTER_LOG */
 #include "tsc.h"		/* TSC structure, diff_tsc(), calibrate... */
+#include "prefault.h"		/* prefault(), page_faults() */
 
 int main(void)
 {
   double cpu_microsecs_per_cycle;
   double delta;
-  TSC * tsc_array;
-  TSC this_tsc, zero_tsc = {0, 0};
+  JITTER_LOG * jitter_log;
+  TSC this_tsc;
+  long faults_start, faults_prefault;
   int t;
 
   cpu_microsecs_per_cycle = calibrate_cpu_secs_per_cycle() * 1.0e6;
 
-  tsc_array = rtai_malloc(SHM_KEY, SHM_HOWMANY * sizeof(TSC));
-  if (0 == tsc_array) {
+  jitter_log = rtai_malloc(SHM_KEY, sizeof(JITTER_LOG));
+  if (0 == jitter_log) {
     fprintf(stderr, "can't allocate shared memory\n");
     return 1;
   }
 
+  faults_start = page_faults();
+  if (0 != prefault(jitter_log, sizeof(JITTER_LOG),
+		    NULL != getenv("SHM_HUGE"))) {
+    fprintf(stderr, "can't lock shared memory, continuing\n");
+  }
+  faults_prefault = page_faults();
+
   /*
-    Wait for TSC log to fill up by looking at the last one, which
-    was initially set to zero by the RT task and will be the last
-    one written. It's possible that the last TSC could be legitimately
-    zero, in which case the loop will never end. The odds of this are
-    one in 2^64, or one in 18,446,744,073,709,551,616.
+    Wait for TSC log to fill up, which the RT task tells us by
+    setting the 'ready' flag. We don't need to spin on this, since
+    the log takes a while to fill, but we give up after a few seconds,
+    in case the RT task isn't loaded. Then check that it laid out the
+    log the way we expect.
   */
-  do {
-    this_tsc = tsc_array[SHM_HOWMANY - 1];
-  } while (tsc_isequal(this_tsc, zero_tsc));
+  t = shm_header_wait(&jitter_log->header, JITTER_MAGIC, 5000);
+  if (0 != t) {
+    fprintf(stderr, t < 0 ? "shared memory has no header, "
+	    "is jitter_mod loaded?\n" : "TSC log never filled up\n");
+    rtai_free(SHM_KEY, jitter_log);
+    return 1;
+  }
+  if (0 != shm_header_check(&jitter_log->header, JITTER_MAGIC,
+			    JITTER_VERSION, sizeof(JITTER_LOG), SHM_HOWMANY)) {
+    fprintf(stderr, "shared memory layout doesn't match, "
+	    "rebuild the RT task and this program together\n");
+    rtai_free(SHM_KEY, jitter_log);
+    return 1;
+  }
 
   /*
     Difference the time stamp values, convert to seconds and print them out.
    */
   for (t = 1; t < SHM_HOWMANY; t++) {
-    diff_tsc(tsc_array[t], tsc_array[t - 1], &this_tsc);
+    diff_tsc(jitter_log->tsc[t], jitter_log->tsc[t - 1], &this_tsc);
     delta = tsc_to_double(this_tsc);
     delta *= cpu_microsecs_per_cycle;
     printf("%f\n", delta);
   }
 
-  rtai_free(SHM_KEY, tsc_array);
+  fprintf(stderr, "page faults prefault/run: %ld/%ld\n",
+	  faults_prefault - faults_start, page_faults() - faults_prefault);
+
+  rtai_free(SHM_KEY, jitter_log);
 
   return 0;
 }
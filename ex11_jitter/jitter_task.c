@@ -14,7 +14,7 @@
 #include "rtai_sched.h"
 #include "rtai_shm.h"
 #include "tsc.h"		/* TSC structure, get_tsc() */
-#include "common.h"		/* SHM_KEY, SHM_HOWMANY */
+#include "common.h"		/* SHM_KEY, SHM_HOWMANY, JITTER_LOG */
 
 /*
   Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
@@ -42,11 +42,12 @@ MODULE_LICENSE("GPL");
 static RT_TASK jitter_task;	/* we'll fill this in with our task */
 static RTIME jitter_period_ns = PERIOD_NSEC; /* timer period, in nanoseconds */
 
-static TSC * tsc_array = 0;
+static JITTER_LOG * jitter_log = 0;
 
 /*
   jitter_function() is our task code, which reads the time stamp counter
-  and logs it into the shared memory buffer until it's full.
+  and logs it into the shared memory buffer until it's full, then
+  tells the reader it's ready.
  */
 void jitter_function(int arg)
 {
@@ -56,8 +57,11 @@ void jitter_function(int arg)
   while (1) {
     /* inhibit logging if we're full */
     if (index < SHM_HOWMANY) {
-      get_tsc(&tsc_array[index]); /* read time stamp into the log */
+      get_tsc(&jitter_log->tsc[index]); /* read time stamp into the log */
       index++;			/* move index to next one */
+      if (index == SHM_HOWMANY) {
+	shm_header_ready(&jitter_log->header); /* after the last TSC */
+      }
     }
     rt_task_wait_period();	/* and wait */
   }
@@ -72,13 +76,15 @@ int init_module(void)
   RTIME jitter_period_count;
   TSC zero_tsc = {0, 0};
 
-  /* get shared memory and fill it with the zero timestamp */
-  tsc_array = rtai_kmalloc(SHM_KEY, SHM_HOWMANY * sizeof(TSC));
-  if (0 == tsc_array) {
+  /* get shared memory, describe it and fill it with the zero timestamp */
+  jitter_log = rtai_kmalloc(SHM_KEY, sizeof(JITTER_LOG));
+  if (0 == jitter_log) {
     return -ENOMEM;
   }
+  shm_header_init(&jitter_log->header, JITTER_MAGIC, JITTER_VERSION,
+		  sizeof(JITTER_LOG), SHM_HOWMANY);
   for (t = 0; t < SHM_HOWMANY; t++) {
-    tsc_array[t] = zero_tsc;
+    jitter_log->tsc[t] = zero_tsc;
   }
 
   rt_set_periodic_mode();
@@ -103,6 +109,7 @@ void cleanup_module(void)
 {
   rt_task_delete(&jitter_task);
 
+  jitter_log->header.ready = 0;
   rtai_kfree(SHM_KEY);
 
   return;
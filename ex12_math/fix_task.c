@@ -0,0 +1,347 @@
+/*
+  fix_task.c
+
+  The task from math_task.c done in fixed point, with fixmath.c, so it
+  doesn't use the FPU at all and is made with 'uses_fpu' 0. Like
+  math_task, it steps an angle along, computes the sine and cosine, and
+  checks that sin^2 + cos^2 = 1; it also runs a PID loop, driving a
+  simulated plant to follow the sine. Since it never touches the FPU,
+  its switches don't save or restore it, and it can't hurt Linux's
+  floating point, whatever 'rt_task_use_fpu()' says.
+
+  If FIX_BENCH is set, which it is by default, a second task first
+  compares the fixed point functions with the rtai_math ones, in CPU
+  cycles per evaluation, and then compares the time per switch between
+  two tasks each doing a sine and cosine, in fixed point without FPU
+  save/restore and in floating point with it. That task has to use
+  the FPU, for the floating point side. The cycles are counts of the
+  CPU time stamp counter, which is what rt_get_time() returns in
+  one-shot mode. The results go to the kernel log.
+*/
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/sched.h>
+#include <rtai.h>
+#include <rtai_sched.h>
+#include <rtai_math.h>
+#include "fixmath.h"
+
+/*
+  Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
+  get that if necessary
+ */
+#if ! defined(RT_LOWEST_PRIORITY)
+#if defined(RT_SCHED_LOWEST_PRIORITY)
+#define RT_LOWEST_PRIORITY RT_SCHED_LOWEST_PRIORITY
+#else
+#error RT_SCHED_LOWEST_PRIORITY not defined
+#endif
+#endif
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+
+  When linked into the Linux kernel the resulting work is GPL. You
+  are free to use this work under other licenses if you wish.
+*/
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2,4,0)
+MODULE_LICENSE("GPL");
+#endif
+
+int FIX_BENCH = 1;
+module_param(FIX_BENCH, int, 0);
+
+#define STACKSIZE 2048		/* room for rt_printk() in the benchmark */
+
+static RT_TASK fix_task;
+static RT_TASK bench_task;
+static RT_TASK pong_task;
+
+/*
+  What the fixed point task has seen, reported when we're unloaded.
+ */
+static int cycles = 0;
+static int identity_err_max = 0; /* worst |sin^2 + cos^2 - 1|, in 1/65536 */
+static int track_err_max = 0;	/* worst PID tracking error, in 1/65536 */
+
+#define SETTLE_CYCLES 1000	/* before we count the tracking error */
+
+static void fix_code(int arg)
+{
+  fix_t angle = 0;
+  fix_t s, c, err;
+  fix_t plant = 0, drive;
+  FIX_PID pid;
+  fix_acc_t one;
+
+  /*
+    The plant moves an eighth of the way to its drive each period, and
+    the PID drives it to follow the sine.
+   */
+  fix_pid_init(&pid, FIX(4.0), FIX(0.5), FIX(0.0), FIX(-8.0), FIX(8.0));
+
+  while (1) {
+    fix_sincos(angle, &s, &c);
+    one = fix_mac(fix_mac(0, s, s), c, c);
+    err = fix_from_acc(one) - FIX_ONE;
+    err = err < 0 ? -err : err;
+    if (err > identity_err_max) identity_err_max = err;
+
+    drive = fix_pid_update(&pid, s, plant);
+    plant += (drive - plant) >> 3;
+    err = s - plant;
+    err = err < 0 ? -err : err;
+    if (cycles > SETTLE_CYCLES && err > track_err_max) track_err_max = err;
+
+    angle += FIX(0.01);		/* about half a degree */
+    angle = angle > FIX_PI ? angle - 2 * FIX_PI : angle;
+    cycles++;
+    rt_task_wait_period();
+  }
+
+  return;
+}
+
+/*
+  The benchmark. Each function is run on BENCH_N arguments, BENCH_RUNS
+  times, and the fastest run is taken, to leave out interrupts.
+ */
+#define BENCH_N 256
+#define BENCH_RUNS 100
+#define SWITCH_ROUNDS 10000
+
+static fix_t fix_x[BENCH_N], fix_y[BENCH_N], fix_out[BENCH_N], fix_out2[BENCH_N];
+static double dbl_x[BENCH_N], dbl_y[BENCH_N], dbl_out[BENCH_N], dbl_out2[BENCH_N];
+
+/*
+  A floating point PID, the same as fix_pid_update(), to compare.
+ */
+typedef struct {
+  double kp, ki, kd, out_min, out_max, integral, prev_error;
+} DBL_PID;
+
+static double dbl_pid_update(DBL_PID * pid, double setpoint, double measured)
+{
+  double error = setpoint - measured;
+  double out;
+
+  pid->integral += pid->ki * error;
+  pid->integral = pid->integral > pid->out_max ? pid->out_max :
+    pid->integral < pid->out_min ? pid->out_min : pid->integral;
+  out = pid->integral + pid->kp * error + pid->kd * (error - pid->prev_error);
+  pid->prev_error = error;
+
+  return out > pid->out_max ? pid->out_max : out < pid->out_min ? pid->out_min : out;
+}
+
+/*
+  BENCH() sets 'best' to the fewest counts of BENCH_RUNS runs of 'CALL'
+  for each 't' in 0..BENCH_N-1.
+ */
+#define BENCH(best, CALL)				\
+  best = 0;						\
+  for (run = 0; run < BENCH_RUNS; run++) {		\
+    start = rt_get_time();				\
+    for (t = 0; t < BENCH_N; t++) {			\
+      CALL;						\
+    }							\
+    start = rt_get_time() - start;			\
+    if (0 == best || start < best) best = start;	\
+  }
+
+static void bench_print(const char * name, RTIME fix, RTIME dbl)
+{
+  int f = (int) fix * 100 / BENCH_N;
+  int d = (int) dbl * 100 / BENCH_N;
+
+  rt_printk("fix bench: %s: fixed %d.%02d, double %d.%02d cycles each\n",
+	    name, f / 100, f % 100, d / 100, d % 100);
+}
+
+static int pong_fpu = 0;
+
+/*
+  pong_task answers each switch to it with a sine and cosine, in
+  floating point if it's saving the FPU, else in fixed point.
+ */
+static void pong_code(int arg)
+{
+  fix_t s, c;
+  double ds, dc;
+
+  while (1) {
+    if (pong_fpu) {
+      ds = sin(dbl_x[0]);
+      dc = cos(dbl_x[0]);
+      dbl_out[0] = ds + dc;
+    } else {
+      fix_sincos(fix_x[0], &s, &c);
+      fix_out[0] = s + c;
+    }
+    rt_task_suspend(rt_whoami());
+  }
+
+  return;
+}
+
+/*
+  switch_counts() returns the counts per switch, when both tasks do
+  a sine and cosine each time, with or without the FPU.
+ */
+static int switch_counts(int use_fpu)
+{
+  RTIME start;
+  fix_t s, c;
+  double ds, dc;
+  int r;
+
+  rt_task_use_fpu(&bench_task, use_fpu);
+  rt_task_use_fpu(&pong_task, use_fpu);
+  pong_fpu = use_fpu;
+
+  start = rt_get_time();
+  for (r = 0; r < SWITCH_ROUNDS; r++) {
+    if (use_fpu) {
+      ds = sin(dbl_x[1]);
+      dc = cos(dbl_x[1]);
+      dbl_out[1] = ds + dc;
+    } else {
+      fix_sincos(fix_x[1], &s, &c);
+      fix_out[1] = s + c;
+    }
+    rt_task_resume(&pong_task);
+  }
+  start = rt_get_time() - start;
+
+  rt_task_use_fpu(&bench_task, 1);
+
+  return (int) start / (2 * SWITCH_ROUNDS);
+}
+
+static void bench_code(int arg)
+{
+  RTIME start, fix, dbl;
+  fix_acc_t acc;
+  double sum;
+  FIX_PID fpid;
+  DBL_PID dpid = {4.0, 0.5, 0.0, -8.0, 8.0, 0.0, 0.0};
+  int run, t, sw_fix, sw_dbl;
+
+  /* angles over a few turns, and points all around the circle */
+  for (t = 0; t < BENCH_N; t++) {
+    dbl_x[t] = (t - BENCH_N / 2) * 0.0731;
+    dbl_y[t] = (t % 17 - 8) * 0.37;
+    fix_x[t] = (fix_t) (dbl_x[t] * FIX_ONE);
+    fix_y[t] = (fix_t) (dbl_y[t] * FIX_ONE);
+  }
+
+  BENCH(fix, fix_sincos(fix_x[t], &fix_out[t], &fix_out2[t]));
+  BENCH(dbl, dbl_out[t] = sin(dbl_x[t]); dbl_out2[t] = cos(dbl_x[t]));
+  bench_print("sin and cos", fix, dbl);
+
+  BENCH(fix, fix_out[t] = fix_atan2(fix_y[t], fix_x[t]));
+  BENCH(dbl, dbl_out[t] = atan2(dbl_y[t], dbl_x[t]));
+  bench_print("atan2", fix, dbl);
+
+  BENCH(fix, fix_out[t] = fix_sqrt(fix_x[t] < 0 ? -fix_x[t] : fix_x[t]));
+  BENCH(dbl, dbl_out[t] = sqrt(fabs(dbl_x[t])));
+  bench_print("sqrt", fix, dbl);
+
+  /* a multiply-accumulate, as in a BENCH_N-tap filter */
+  acc = 0;
+  BENCH(fix, acc = fix_mac(acc, fix_x[t], fix_y[t]));
+  fix_out[0] = fix_from_acc(acc);
+  sum = 0.0;
+  BENCH(dbl, sum += dbl_x[t] * dbl_y[t]);
+  dbl_out[0] = sum;
+  bench_print("multiply-accumulate", fix, dbl);
+
+  fix_pid_init(&fpid, FIX(4.0), FIX(0.5), FIX(0.0), FIX(-8.0), FIX(8.0));
+  BENCH(fix, fix_out[t] = fix_pid_update(&fpid, fix_x[t], fix_y[t]));
+  BENCH(dbl, dbl_out[t] = dbl_pid_update(&dpid, dbl_x[t], dbl_y[t]));
+  bench_print("PID update", fix, dbl);
+
+  sw_fix = switch_counts(0);
+  sw_dbl = switch_counts(1);
+  rt_printk("fix bench: per switch with a sine and cosine: fixed without FPU "
+	    "save %d cycles, double with FPU save %d cycles\n", sw_fix, sw_dbl);
+
+  while (1) {
+    rt_task_suspend(rt_whoami());
+  }
+
+  return;
+}
+
+int init_module(void)
+{
+  int retval;
+  RTIME task_period;
+
+  /*
+    The fixed point task never uses the FPU, so it's made with
+    'uses_fpu' 0, and needs no rt_linux_use_fpu(). The benchmark
+    does, for its floating point side.
+   */
+  retval = rt_task_init(&fix_task, fix_code, 0, 1024, RT_LOWEST_PRIORITY,
+			0,	/* doesn't use the FPU */
+			0);
+  if (retval) {
+    printk("could not init task\n");
+    return retval;
+  }
+
+  if (FIX_BENCH) {
+    rt_linux_use_fpu(1);
+    retval = rt_task_init(&pong_task, pong_code, 0, STACKSIZE, 0, 1, 0);
+    if (0 == retval) {
+      retval = rt_task_init(&bench_task, bench_code, 0, STACKSIZE, 1, 1, 0);
+      if (retval) rt_task_delete(&pong_task);
+    }
+    if (retval) {
+      printk("could not init bench task\n");
+      rt_linux_use_fpu(0);
+      rt_task_delete(&fix_task);
+      return retval;
+    }
+  }
+
+  rt_set_oneshot_mode();
+  start_rt_timer(1);
+  task_period = nano2count(1e5);
+  retval = rt_task_make_periodic(&fix_task,
+				 rt_get_time() + task_period,
+				 task_period);
+  if (retval) {
+    printk("could not start task\n");
+    return retval;
+  }
+  if (FIX_BENCH) {
+    rt_task_resume(&bench_task);
+  }
+
+  return 0;
+}
+
+void cleanup_module(void)
+{
+  rt_task_delete(&fix_task);
+  if (FIX_BENCH) {
+    rt_task_delete(&bench_task);
+    rt_task_delete(&pong_task);
+  }
+
+  stop_rt_timer();
+  if (FIX_BENCH) {
+    rt_linux_use_fpu(0);
+  }
+
+  printk("fix task: %d cycles, sin^2 + cos^2 off by at most %d/65536, "
+	 "PID tracking off by at most %d/65536\n",
+	 cycles, identity_err_max, track_err_max);
+
+  return;
+}
@@ -0,0 +1,222 @@
+/*
+  fixmath.c
+
+  Fixed-point math, for RT tasks that don't use the FPU. See fixmath.h
+  for the number format.
+
+  Sine, cosine and atan2 use CORDIC, which turns a vector through a
+  fixed series of smaller and smaller angles, atan(1), atan(1/2),
+  atan(1/4), ..., each either way, so that each step is just shifts
+  and adds. Turning (1, 0) by the angle we want gives the cosine and
+  sine; turning (x, y) onto the x axis and adding up the steps gives
+  atan2(y, x). Each step adds about a bit, and it always takes
+  CORDIC_STEPS steps, so the time is the same for any angle.
+
+  Inside, the vector is kept with 30 fraction bits and the angles with
+  29, for more bits than the answer needs, so the rounding in the
+  steps doesn't show.
+
+  This file is built with -mno-80387 (see the Makefile), so if any
+  floating point slips in at run time, the module won't load. FIX()
+  and the tables are worked out by the compiler, so they're fine.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include "fixmath.h"
+
+#define CORDIC_STEPS 24
+#define ANGLE_SHIFT 29		/* fraction bits of angles inside */
+#define VEC_SHIFT 30		/* fraction bits of vectors inside */
+#define ANGLE(x) ((int) ((x) * 536870912.0 + 0.5)) /* 2^29 */
+
+/*
+  atan(2^-i), with 29 fraction bits.
+ */
+static const int cordic_angle[CORDIC_STEPS] = {
+  ANGLE(7.85398163397448279e-01), ANGLE(4.63647609000806094e-01),
+  ANGLE(2.44978663126864143e-01), ANGLE(1.24354994546761438e-01),
+  ANGLE(6.24188099959573500e-02), ANGLE(3.12398334302682774e-02),
+  ANGLE(1.56237286204768313e-02), ANGLE(7.81234106010111114e-03),
+  ANGLE(3.90623013196697176e-03), ANGLE(1.95312251647881876e-03),
+  ANGLE(9.76562189559319459e-04), ANGLE(4.88281211194898275e-04),
+  ANGLE(2.44140620149361770e-04), ANGLE(1.22070311893670208e-04),
+  ANGLE(6.10351561742087726e-05), ANGLE(3.05175781155260957e-05),
+  ANGLE(1.52587890613157615e-05), ANGLE(7.62939453110196998e-06),
+  ANGLE(3.81469726560649614e-06), ANGLE(1.90734863281018696e-06),
+  ANGLE(9.53674316405960844e-07), ANGLE(4.76837158203088842e-07),
+  ANGLE(2.38418579101557974e-07), ANGLE(1.19209289550780681e-07)
+};
+
+/*
+  Each step makes the vector longer, by 1.6468 after all of them, so
+  we start with 1/1.6468 instead of 1.
+ */
+#define CORDIC_GAIN_INV ((int) (0.60725293500888125617 * 1073741824.0 + 0.5))
+
+/*
+  2pi, pi and pi/2 with 29 fraction bits, for bringing angles around.
+  FIX_2PI is off by up to 1/131072, and that would add up with each
+  turn taken off, to about 0.01 by 32767, so the angle is taken off
+  in these instead, which are good to 1/2^30, about 0.000005 by 32767.
+  They need 64 bits, but only adds and a multiply, which, unlike a
+  64-bit divide, a 32-bit kernel can do without a library call.
+ */
+#define ANGLE_2PI 3373259426LL
+#define ANGLE_PI 1686629713LL
+#define ANGLE_PI_2 843314857LL
+
+#define FIX_2PI FIX(6.28318530717958647692)
+
+void fix_sincos(fix_t angle, fix_t * s, fix_t * c)
+{
+  long long a;
+  int x, y, z, dx, dy, d, flip, i;
+
+  /*
+    Bring the angle into -pi..pi, then into -pi/2..pi/2, where CORDIC
+    works, using sin(pi - a) = sin(a) and cos(pi - a) = -cos(a). The
+    number of turns from a 32-bit divide by FIX_2PI may be one short,
+    leaving the angle up to just over a turn away, which the first
+    step of folding takes care of.
+   */
+  a = (long long) angle << (ANGLE_SHIFT - FIX_SHIFT);
+  a -= (long long) (angle / FIX_2PI) * ANGLE_2PI;
+  a = a > ANGLE_PI ? a - ANGLE_2PI : a;
+  a = a < -ANGLE_PI ? a + ANGLE_2PI : a;
+  flip = (a > ANGLE_PI_2) | (a < -ANGLE_PI_2);
+  a = a > ANGLE_PI_2 ? ANGLE_PI - a : a;
+  a = a < -ANGLE_PI_2 ? -ANGLE_PI - a : a;
+
+  x = CORDIC_GAIN_INV;
+  y = 0;
+  z = (int) a;
+  for (i = 0; i < CORDIC_STEPS; i++) {
+    /* turn toward z = 0; d is 0 to turn up, -1 to turn down */
+    d = z >> 31;
+    dx = ((y >> i) ^ d) - d;
+    dy = ((x >> i) ^ d) - d;
+    x -= dx;
+    y += dy;
+    z -= (cordic_angle[i] ^ d) - d;
+  }
+
+  /* round to 16 fraction bits */
+  x = (x + (1 << (VEC_SHIFT - FIX_SHIFT - 1))) >> (VEC_SHIFT - FIX_SHIFT);
+  y = (y + (1 << (VEC_SHIFT - FIX_SHIFT - 1))) >> (VEC_SHIFT - FIX_SHIFT);
+  *s = y;
+  *c = flip ? -x : x;
+}
+
+fix_t fix_sin(fix_t angle)
+{
+  fix_t s, c;
+
+  fix_sincos(angle, &s, &c);
+
+  return s;
+}
+
+fix_t fix_cos(fix_t angle)
+{
+  fix_t s, c;
+
+  fix_sincos(angle, &s, &c);
+
+  return c;
+}
+
+fix_t fix_atan2(fix_t y, fix_t x)
+{
+  long long vx, vy, t;
+  fix_t base;
+  int z, d, i;
+
+  /*
+    Turn the left half-plane over to the right, and remember the half
+    turn. Shift up, so small vectors keep their bits; 64 bits has room
+    for that and the CORDIC gain.
+   */
+  base = x >= 0 ? 0 : y >= 0 ? FIX_PI : -FIX_PI;
+  vx = (long long) (x >= 0 ? x : -(long long) x) << 16;
+  vy = (long long) (x >= 0 ? y : -(long long) y) << 16;
+
+  z = 0;
+  for (i = 0; i < CORDIC_STEPS; i++) {
+    /* turn toward the x axis, or not at all once we're on it */
+    d = (vy > 0) - (vy < 0);
+    t = vx;
+    vx += d * (vy >> i);
+    vy -= d * (t >> i);
+    z += d * cordic_angle[i];
+  }
+
+  /* round to 16 fraction bits */
+  z = (z + (1 << (ANGLE_SHIFT - FIX_SHIFT - 1))) >> (ANGLE_SHIFT - FIX_SHIFT);
+
+  return base + z;
+}
+
+fix_t fix_sqrt(fix_t a)
+{
+  unsigned long long n, root, bit, trial;
+  int i;
+
+  /*
+    The root of a * 2^16, as an integer, is the root of 'a' with 16
+    fraction bits. Work it out a bit at a time, from the top.
+   */
+  n = (unsigned long long) (a > 0 ? a : 0) << FIX_SHIFT;
+  root = 0;
+  bit = 1ULL << 46;
+  for (i = 0; i < 24; i++) {
+    trial = root + bit;
+    if (n >= trial) {
+      n -= trial;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return (fix_t) root;
+}
+
+void fix_pid_init(FIX_PID * pid, fix_t kp, fix_t ki, fix_t kd,
+		  fix_t out_min, fix_t out_max)
+{
+  pid->kp = kp;
+  pid->ki = ki;
+  pid->kd = kd;
+  pid->out_min = out_min;
+  pid->out_max = out_max;
+  pid->integral = 0;
+  pid->prev_error = 0;
+  pid->primed = 0;
+}
+
+fix_t fix_pid_update(FIX_PID * pid, fix_t setpoint, fix_t measured)
+{
+  fix_acc_t lo = (fix_acc_t) pid->out_min << FIX_SHIFT;
+  fix_acc_t hi = (fix_acc_t) pid->out_max << FIX_SHIFT;
+  fix_acc_t acc;
+  fix_t error, change;
+
+  error = fix_sat((long long) setpoint - measured);
+  change = pid->primed ? fix_sat((long long) error - pid->prev_error) : 0;
+  pid->prev_error = error;
+  pid->primed = 1;
+
+  pid->integral = fix_mac(pid->integral, pid->ki, error);
+  pid->integral = pid->integral > hi ? hi : pid->integral < lo ? lo : pid->integral;
+
+  acc = fix_mac(pid->integral, pid->kp, error);
+  acc = fix_mac(acc, pid->kd, change);
+  acc = acc > hi ? hi : acc < lo ? lo : acc;
+
+  return fix_from_acc(acc);
+}
@@ -0,0 +1,108 @@
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+/*
+  fixmath.h
+
+  Declarations for fixed-point math, for RT tasks that would rather
+  not use the FPU at all. A task that never touches the FPU can be
+  made with 'uses_fpu' 0, so its switches don't save and restore the
+  FPU, and it can't clobber Linux's floating point if it forgets.
+
+  Numbers are Q16.16: a 32-bit int holding the value times 65536, so
+  the range is -32768 to 32767.99998 with a resolution of 1/65536.
+  Angles are in radians, in the same format. Nothing here loses more
+  than a few of the low bits, except where noted, and each function
+  takes the same time whatever its arguments.
+*/
+
+typedef int fix_t;		/* Q16.16 */
+typedef long long fix_acc_t;	/* Q32.32, for sums of products */
+
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)
+#define FIX_MAX 0x7FFFFFFF
+#define FIX_MIN (-FIX_MAX - 1)
+
+/*
+  FIX() converts a constant to fixed point, when compiling, so no
+  floating point is left in the code. Use it only on constants.
+ */
+#define FIX(x) ((fix_t) ((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define FIX_FROM_INT(i) ((fix_t) (i) << FIX_SHIFT)
+#define FIX_TO_INT(a) ((a) >> FIX_SHIFT) /* rounds down */
+
+#define FIX_PI FIX(3.14159265358979323846)
+#define FIX_PI_2 FIX(1.57079632679489661923)
+
+/*
+  fix_sat() clamps a 64-bit value into the range of a fix_t.
+ */
+static inline fix_t fix_sat(long long a)
+{
+  return a > FIX_MAX ? FIX_MAX : a < FIX_MIN ? FIX_MIN : (fix_t) a;
+}
+
+/*
+  fix_mul() returns a * b, rounded, and saturated if it's out of range.
+ */
+static inline fix_t fix_mul(fix_t a, fix_t b)
+{
+  return fix_sat(((long long) a * b + (FIX_ONE >> 1)) >> FIX_SHIFT);
+}
+
+/*
+  fix_mac() returns 'acc' + a * b, with the full 64-bit product, so a
+  long sum of products, like a filter, only rounds once, at the end,
+  in fix_from_acc().
+ */
+static inline fix_acc_t fix_mac(fix_acc_t acc, fix_t a, fix_t b)
+{
+  return acc + (long long) a * b;
+}
+
+static inline fix_t fix_from_acc(fix_acc_t acc)
+{
+  return fix_sat((acc + (FIX_ONE >> 1)) >> FIX_SHIFT);
+}
+
+/*
+  fix_sincos() puts the sine and cosine of 'angle' in 's' and 'c',
+  good to about 1/32768 for any angle in range. fix_sin() and
+  fix_cos() are shorthand.
+ */
+extern void fix_sincos(fix_t angle, fix_t * s, fix_t * c);
+extern fix_t fix_sin(fix_t angle);
+extern fix_t fix_cos(fix_t angle);
+
+/*
+  fix_atan2() returns the angle of the point (x, y), like atan2(y, x),
+  good to about 1/32768.
+ */
+extern fix_t fix_atan2(fix_t y, fix_t x);
+
+/*
+  fix_sqrt() returns the square root of 'a', rounded down, or 0 if 'a'
+  is negative.
+ */
+extern fix_t fix_sqrt(fix_t a);
+
+/*
+  A PID controller. The gains are per sample, so fold the sample time
+  into 'ki' and 'kd': ki = Ki * dt, kd = Kd / dt. The integral is
+  clamped so that it alone can't push the output past its limits,
+  which keeps it from winding up while the output is saturated.
+ */
+typedef struct {
+  fix_t kp, ki, kd;		/* gains */
+  fix_t out_min, out_max;	/* output limits */
+  fix_acc_t integral;		/* sum of ki * error, Q32.32 */
+  fix_t prev_error;		/* last error, for the derivative */
+  int primed;			/* whether there's a last error yet */
+} FIX_PID;
+
+extern void fix_pid_init(FIX_PID * pid, fix_t kp, fix_t ki, fix_t kd,
+			 fix_t out_min, fix_t out_max);
+extern fix_t fix_pid_update(FIX_PID * pid, fix_t setpoint, fix_t measured);
+
+#endif /* FIXMATH_H */
@@ -0,0 +1,452 @@
+/*
+  fpu_bench.c
+
+  Measures what FPU save/restore costs, and what happens without it,
+  so you can decide which tasks need it. math_task.c shows that a task
+  that uses floating point without it wrecks Linux's floating point;
+  this puts numbers on both sides.
+
+  First, two RT tasks, 'bench_task' and the higher-priority
+  'pong_task', switch back and forth SWITCH_ROUNDS times. Before each
+  switch, bench_task leaves a pattern in the FPU registers, and
+  pong_task leaves a different one; when bench_task gets back, it
+  checks that its pattern is still there. This is done for each kind
+  of register the CPU has, the x87 control word, the SSE registers
+  and the AVX registers, plus none at all, first with both tasks
+  saving the FPU and then with neither. The difference in time per
+  switch is the cost of the save/restore, and the registers that
+  changed without it are the corruption you'd get.
+
+  Then bench_task runs periodically, doing some floating point each
+  period and leaving its pattern in the registers before it sleeps,
+  through phases of PHASE_MS milliseconds: a baseline where it just
+  sleeps, then for each kind of register, x87, SSE and AVX, as far as
+  the CPU has them, each of the PERIODS_US periods with and without
+  FPU save/restore. RTAI saves the same area, with fnsave or fxsave,
+  whichever registers a task touched, so this isn't a sweep of how
+  much is saved; the cost shouldn't change from one kind to the next.
+  It checks that what's saved covers each kind: a task's AVX pattern
+  coming back wrong even with FPU save/restore most likely means
+  RTAI's save doesn't cover the upper halves of the ymm registers,
+  not a bug here. Run 'fpu_load' at the same time,
+  which does floating point in Linux as fast as it can, and it will
+  show how much each phase slows it down and how many of its answers
+  were wrong, along with the results here. The results are also
+  printed to the kernel log.
+
+  Without FPU save/restore, Linux floating point will be wrong at
+  times while this runs. That's the point, but don't run it alongside
+  anything that matters.
+*/
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/sched.h>
+#include <asm/cpufeature.h>	/* boot_cpu_has() */
+#include <rtai.h>
+#include <rtai_sched.h>
+#include <rtai_shm.h>		/* rtai_kmalloc(), rtai_kfree() */
+#include "fpu_bench.h"
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+
+  When linked into the Linux kernel the resulting work is GPL. You
+  are free to use this work under other licenses if you wish.
+*/
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2,4,0)
+MODULE_LICENSE("GPL");
+#endif
+
+int SWITCH_ROUNDS = 10000;
+module_param(SWITCH_ROUNDS, int, 0);
+
+int PHASE_MS = 2000;
+module_param(PHASE_MS, int, 0);
+
+static int PERIODS_US[FPU_BENCH_MAX_PERIODS] = {1000, 200, 100, 50, 20};
+static int periods = 5;
+module_param_array(PERIODS_US, int, &periods, 0);
+
+/*
+  FPU_STATE is which registers the periodic task leaves its pattern in,
+  1 for x87, 2 for SSE, 3 for AVX, or -1 for each the CPU has in turn.
+  FPU_WORK is how many terms of the sum it adds up each period.
+ */
+int FPU_STATE = -1;
+module_param(FPU_STATE, int, 0);
+
+int FPU_WORK = 1000;
+module_param(FPU_WORK, int, 0);
+
+#define STACKSIZE 2048		/* room for rt_printk() */
+
+static RT_TASK bench_task;
+static RT_TASK pong_task;
+static FPU_BENCH * bench = 0;
+static int have_state[FPU_STATES];
+static const char * state_name[] = FPU_STATE_NAMES;
+
+/*
+  What each task leaves in the registers. The x87 patterns both set
+  single precision, so if one leaks into Linux, its sums go wrong.
+ */
+typedef struct {
+  unsigned short cw;		/* x87 control word */
+  unsigned int vec[8] __attribute__ ((aligned (32))); /* SSE, AVX */
+} FPU_PATTERN;
+
+static FPU_PATTERN pattern_bench = {
+  0x0C7F, {0xDEADBEEF, 0x01234567, 0x89ABCDEF, 0xFEEDFACE,
+	   0xCAFEF00D, 0x76543210, 0xFEDCBA98, 0xBAADF00D}
+};
+static FPU_PATTERN pattern_pong = {
+  0x047F, {0x5A5A5A5A, 0xA5A5A5A5, 0x0F0F0F0F, 0xF0F0F0F0,
+	   0x33333333, 0xCCCCCCCC, 0x55555555, 0xAAAAAAAA}
+};
+
+static const unsigned short x87_default_cw = 0x037F;
+
+static unsigned int fpu_buf[8 * 8] __attribute__ ((aligned (32)));
+
+/*
+  fpu_set() loads 'p' into the registers of kind 'state': the x87
+  control word, or all of xmm0..7 or ymm0..7.
+ */
+static void fpu_set(int state, const FPU_PATTERN * p)
+{
+  switch (state) {
+  case FPU_X87:
+    __asm__ __volatile__ ("fldcw %0" : : "m" (p->cw));
+    break;
+  case FPU_SSE:
+    __asm__ __volatile__ ("movdqu (%0), %%xmm0\n\t"
+			  "movdqu (%0), %%xmm1\n\t"
+			  "movdqu (%0), %%xmm2\n\t"
+			  "movdqu (%0), %%xmm3\n\t"
+			  "movdqu (%0), %%xmm4\n\t"
+			  "movdqu (%0), %%xmm5\n\t"
+			  "movdqu (%0), %%xmm6\n\t"
+			  "movdqu (%0), %%xmm7"
+			  : : "r" (p->vec) : "memory");
+    break;
+  case FPU_AVX:
+    __asm__ __volatile__ ("vmovdqu (%0), %%ymm0\n\t"
+			  "vmovdqu (%0), %%ymm1\n\t"
+			  "vmovdqu (%0), %%ymm2\n\t"
+			  "vmovdqu (%0), %%ymm3\n\t"
+			  "vmovdqu (%0), %%ymm4\n\t"
+			  "vmovdqu (%0), %%ymm5\n\t"
+			  "vmovdqu (%0), %%ymm6\n\t"
+			  "vmovdqu (%0), %%ymm7"
+			  : : "r" (p->vec) : "memory");
+    break;
+  }
+}
+
+/*
+  fpu_check() returns 1 if the registers of kind 'state' still hold
+  'p', else 0. For x87, it also puts the control word back to the
+  default, so the task's own floating point gets full precision.
+ */
+static int fpu_check(int state, const FPU_PATTERN * p)
+{
+  unsigned short cw;
+  int words, t;
+
+  switch (state) {
+  case FPU_X87:
+    __asm__ __volatile__ ("fnstcw %0" : "=m" (cw));
+    __asm__ __volatile__ ("fldcw %0" : : "m" (x87_default_cw));
+    return cw == p->cw;
+  case FPU_SSE:
+    __asm__ __volatile__ ("movdqu %%xmm0, 0(%0)\n\t"
+			  "movdqu %%xmm1, 16(%0)\n\t"
+			  "movdqu %%xmm2, 32(%0)\n\t"
+			  "movdqu %%xmm3, 48(%0)\n\t"
+			  "movdqu %%xmm4, 64(%0)\n\t"
+			  "movdqu %%xmm5, 80(%0)\n\t"
+			  "movdqu %%xmm6, 96(%0)\n\t"
+			  "movdqu %%xmm7, 112(%0)"
+			  : : "r" (fpu_buf) : "memory");
+    words = 4;
+    break;
+  case FPU_AVX:
+    __asm__ __volatile__ ("vmovdqu %%ymm0, 0(%0)\n\t"
+			  "vmovdqu %%ymm1, 32(%0)\n\t"
+			  "vmovdqu %%ymm2, 64(%0)\n\t"
+			  "vmovdqu %%ymm3, 96(%0)\n\t"
+			  "vmovdqu %%ymm4, 128(%0)\n\t"
+			  "vmovdqu %%ymm5, 160(%0)\n\t"
+			  "vmovdqu %%ymm6, 192(%0)\n\t"
+			  "vmovdqu %%ymm7, 224(%0)"
+			  : : "r" (fpu_buf) : "memory");
+    words = 8;
+    break;
+  default:
+    return 1;
+  }
+
+  for (t = 0; t < 8 * words; t++) {
+    if (fpu_buf[t] != p->vec[t % words]) return 0;
+  }
+
+  return 1;
+}
+
+static int pong_state = FPU_NONE;
+
+/*
+  pong_task runs each time bench_task resumes it, leaves its pattern
+  and suspends itself, which switches back.
+ */
+static void pong_code(int arg)
+{
+  while (1) {
+    fpu_set(pong_state, &pattern_pong);
+    rt_task_suspend(rt_whoami());
+  }
+
+  return;
+}
+
+/*
+  switch_test() times SWITCH_ROUNDS round trips to pong_task, with the
+  patterns in the registers of kind 'state', and both tasks saving the
+  FPU or not according to 'use_fpu'.
+ */
+static void switch_test(int state, int use_fpu)
+{
+  FPU_SWITCH * sw = &bench->sw[use_fpu][state];
+  RTIME start, total;
+  int r;
+
+  rt_task_use_fpu(&bench_task, use_fpu);
+  rt_task_use_fpu(&pong_task, use_fpu);
+  pong_state = state;
+
+  sw->rounds = SWITCH_ROUNDS;
+  sw->bad = 0;
+  start = rt_get_cpu_time_ns();
+  for (r = 0; r < SWITCH_ROUNDS; r++) {
+    fpu_set(state, &pattern_bench);
+    rt_task_resume(&pong_task);
+    if (! fpu_check(state, &pattern_bench)) {
+      sw->bad++;
+    }
+  }
+  total = rt_get_cpu_time_ns() - start;
+  sw->switch_ns = (int) total / (2 * SWITCH_ROUNDS);
+
+  rt_printk("fpu bench: %s state, %s FPU save, %d nsecs per switch, "
+	    "%d of %d rounds corrupted\n",
+	    state_name[state], use_fpu ? "with" : "without",
+	    sw->switch_ns, sw->bad, SWITCH_ROUNDS);
+}
+
+/*
+  work() is the task's floating point for each period, a sum that
+  comes out exact. Returns 1 if it's right, else 0.
+ */
+static int work(void)
+{
+  double sum = 0.0;
+  int t;
+
+  for (t = 0; t < FPU_WORK; t++) {
+    sum += t * 0.5;
+  }
+
+  return sum == (double) FPU_WORK * (FPU_WORK - 1) / 4.0;
+}
+
+/*
+  run_phase() runs one phase of the sweep.
+ */
+static void run_phase(FPU_PHASE * ph, int state)
+{
+  RTIME period, next, end, start, busy;
+
+  rt_task_use_fpu(rt_whoami(), ph->use_fpu);
+  ph->cycles = 0;
+  ph->bad = 0;
+  ph->busy_max_ns = 0;
+
+  end = rt_get_time() + nano2count((RTIME) PHASE_MS * 1000000);
+  if (0 == ph->period_us) {
+    rt_sleep_until(end);
+    return;
+  }
+
+  period = nano2count((RTIME) ph->period_us * 1000);
+  next = rt_get_time() + period;
+  fpu_set(state, &pattern_bench);
+  while (next < end) {
+    rt_sleep_until(next);
+    start = rt_get_cpu_time_ns();
+    /* see if our pattern made it through the sleep, then do the work */
+    if (! fpu_check(state, &pattern_bench)) {
+      ph->bad++;
+    } else if (! work()) {
+      ph->bad++;
+    }
+    fpu_set(state, &pattern_bench);
+    busy = rt_get_cpu_time_ns() - start;
+    if (busy > ph->busy_max_ns) {
+      ph->busy_max_ns = (int) busy;
+    }
+    ph->cycles++;
+    next += period;
+  }
+}
+
+static void bench_code(int arg)
+{
+  FPU_PHASE * ph;
+  int state, p;
+
+  for (state = 0; state < FPU_STATES; state++) {
+    if (have_state[state]) {
+      switch_test(state, 1);
+      switch_test(state, 0);
+    }
+  }
+  rt_task_use_fpu(&bench_task, 1);
+
+  for (p = 0; p < bench->phases; p++) {
+    ph = &bench->phase[p];
+    bench->current = p;
+    run_phase(ph, ph->state);
+    rt_printk("fpu bench: %s state, period %d usecs, %s FPU save, "
+	      "%d cycles, %d corrupted, busy max %d nsecs\n",
+	      state_name[ph->state], ph->period_us,
+	      ph->use_fpu ? "with" : "without",
+	      ph->cycles, ph->bad, ph->busy_max_ns);
+  }
+  rt_task_use_fpu(&bench_task, 1);
+  bench->current = bench->phases;
+  rt_printk("fpu bench: done\n");
+
+  while (1) {
+    rt_task_suspend(rt_whoami());
+  }
+
+  return;
+}
+
+int init_module(void)
+{
+  int retval;
+  int first, last, state;
+  int p, t;
+
+  /*
+    We can't tell how big the state RTAI saves is, but we can tell
+    which registers there are to be saved.
+   */
+  have_state[FPU_NONE] = 1;
+  have_state[FPU_X87] = 1;
+  have_state[FPU_SSE] = boot_cpu_has(X86_FEATURE_XMM2);
+#ifdef X86_FEATURE_AVX
+  have_state[FPU_AVX] = boot_cpu_has(X86_FEATURE_AVX);
+#else
+  have_state[FPU_AVX] = 0;
+#endif
+
+  if (FPU_STATE < 0) {
+    first = FPU_X87;
+    last = FPU_STATES - 1;
+  } else if (FPU_STATE > FPU_NONE && FPU_STATE < FPU_STATES &&
+	     have_state[FPU_STATE]) {
+    first = last = FPU_STATE;
+  } else {
+    printk("fpu bench: this CPU doesn't have FPU_STATE %d\n", FPU_STATE);
+    return -EINVAL;
+  }
+  if (periods > FPU_BENCH_MAX_PERIODS) {
+    periods = FPU_BENCH_MAX_PERIODS;
+  }
+
+  bench = rtai_kmalloc(FPU_BENCH_KEY, sizeof(FPU_BENCH));
+  if (0 == bench) {
+    return -ENOMEM;
+  }
+  bench->magic = FPU_BENCH_MAGIC;
+  bench->version = FPU_BENCH_VERSION;
+  bench->size = sizeof(FPU_BENCH);
+  bench->phase_ms = PHASE_MS;
+  bench->current = -1;
+  for (t = 0; t < FPU_STATES; t++) {
+    bench->sw[0][t].rounds = bench->sw[1][t].rounds = 0;
+    bench->sw[0][t].switch_ns = bench->sw[1][t].switch_ns = -1;
+    bench->sw[0][t].bad = bench->sw[1][t].bad = 0;
+  }
+
+  /*
+    The baseline first, then for each kind of register the CPU has,
+    each period with and without the FPU saved.
+   */
+  bench->phase[0].state = FPU_NONE;
+  bench->phase[0].period_us = 0;
+  bench->phase[0].use_fpu = 1;
+  bench->phases = 1;
+  for (state = first; state <= last; state++) {
+    if (! have_state[state]) continue;
+    for (p = 0; p < periods; p++) {
+      for (t = 1; t >= 0; t--) {
+	bench->phase[bench->phases].state = state;
+	bench->phase[bench->phases].period_us = PERIODS_US[p];
+	bench->phase[bench->phases].use_fpu = t;
+	bench->phases++;
+      }
+    }
+  }
+
+  /*
+    Linux's FPU state has to be saved when RT tasks that use it come
+    in. We put this back to the default when we're unloaded.
+   */
+  rt_linux_use_fpu(1);
+
+  /*
+    Both tasks start out saving the FPU, so their saved FPU state is
+    set up, and switch_test() turns it off and on.
+   */
+  retval = rt_task_init(&pong_task, pong_code, 0, STACKSIZE, 0, 1, 0);
+  if (retval) {
+    printk("could not init pong task\n");
+    rt_linux_use_fpu(0);
+    rtai_kfree(FPU_BENCH_KEY);
+    return retval;
+  }
+  retval = rt_task_init(&bench_task, bench_code, 0, STACKSIZE, 1, 1, 0);
+  if (retval) {
+    printk("could not init bench task\n");
+    rt_task_delete(&pong_task);
+    rt_linux_use_fpu(0);
+    rtai_kfree(FPU_BENCH_KEY);
+    return retval;
+  }
+
+  rt_set_oneshot_mode();
+  start_rt_timer(1);
+  rt_task_resume(&bench_task);
+
+  return 0;
+}
+
+void cleanup_module(void)
+{
+  rt_task_delete(&bench_task);
+  rt_task_delete(&pong_task);
+
+  stop_rt_timer();
+  rt_linux_use_fpu(0);
+
+  bench->current = bench->phases;
+  rtai_kfree(FPU_BENCH_KEY);
+
+  return;
+}
@@ -0,0 +1,67 @@
+#ifndef FPU_BENCH_H
+#define FPU_BENCH_H
+
+/*
+  fpu_bench.h
+
+  Layout of the FPU benchmark results, shared between the RT module
+  'fpu_bench' and the Linux load 'fpu_load' that runs alongside it.
+
+  The benchmark has two parts. First, two RT tasks switch back and
+  forth, with and without FPU save/restore, each leaving its own
+  pattern in the FPU registers of each kind, x87, SSE and AVX, and
+  checking it's still there after the other task has run. That gives
+  the cost of a switch, and shows the corruption when the FPU isn't
+  saved.
+
+  Then an RT task runs periodically, doing floating point each period,
+  through a series of phases: first a baseline with no RT load, then
+  for each kind of register, each period with the FPU saved and not. 'current' is the phase
+  running now, which fpu_load reads to know where to count its
+  iterations and its wrong answers. Both sides count corruption: the
+  RT task checks that its registers survive each wait, and fpu_load
+  checks each of its sums.
+*/
+
+#define FPU_BENCH_KEY 104	/* shared memory key, arbitrary */
+#define FPU_BENCH_MAGIC 0x46505542 /* "FPUB" */
+#define FPU_BENCH_VERSION 2
+#define FPU_BENCH_MAX_PERIODS 8
+
+/*
+  The kinds of FPU register state, from smallest to largest.
+ */
+enum {FPU_NONE, FPU_X87, FPU_SSE, FPU_AVX, FPU_STATES};
+
+/* the baseline, then each period with and without, for each kind */
+#define FPU_BENCH_MAX_PHASES (1 + 2 * FPU_BENCH_MAX_PERIODS * (FPU_STATES - 1))
+
+#define FPU_STATE_NAMES {"none", "x87", "sse", "avx"}
+
+typedef struct {
+  int rounds;			/* round trips, two switches each */
+  int switch_ns;		/* average per switch, or -1 if not run */
+  int bad;			/* rounds whose registers were changed */
+} FPU_SWITCH;
+
+typedef struct {
+  int state;			/* registers used, FPU_NONE for baseline */
+  int period_us;		/* task period, 0 for the baseline */
+  int use_fpu;			/* whether the FPU was saved/restored */
+  int cycles;			/* how many periods the RT task ran */
+  int bad;			/* periods whose registers were changed */
+  int busy_max_ns;		/* longest the task ran in one period */
+} FPU_PHASE;
+
+typedef struct {
+  int magic;			/* FPU_BENCH_MAGIC */
+  int version;			/* FPU_BENCH_VERSION */
+  int size;			/* sizeof(FPU_BENCH) */
+  int phase_ms;			/* how long each phase runs */
+  int phases;			/* how many phases in all */
+  volatile int current;		/* phase now, -1 before, 'phases' after */
+  FPU_SWITCH sw[2][FPU_STATES];	/* [use_fpu][state] */
+  FPU_PHASE phase[FPU_BENCH_MAX_PHASES];
+} FPU_BENCH;
+
+#endif /* FPU_BENCH_H */
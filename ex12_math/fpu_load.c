@@ -0,0 +1,160 @@
+/*
+  fpu_load.c
+
+  The Linux side of the FPU benchmark in fpu_bench.c. It adds up the
+  numbers from 1 to a million over and over, like math_app, and checks
+  every sum. As the RT task goes through its phases, we count how many
+  sums we got done in each, and how many were wrong. When it's done,
+  we print the switch times the RT task measured, and what we saw in
+  each phase next to what the RT task saw, e.g.,
+
+  state  period  fpu  rt cycles  rt bad  busy max  sums/sec  slowdown  bad sums
+   none       0  yes          0       0         0      1043     0.0%         0
+    x87    1000  yes       2000       0      2310      1039     0.4%         0
+    x87    1000   no       2000      17      2270      1041     0.2%        35
+  ...
+    avx    1000  yes       2000       0      2450      1037     0.6%         0
+  ...
+
+  The slowdown is how much fewer sums we got done than in the baseline
+  phase, where the RT task just sleeps, and is the time the RT task
+  and its switches took from Linux. Compare the slowdowns with and
+  without FPU save/restore at each period to see what it costs. The
+  phases for each kind of register check that the save covers those
+  registers; the cost should be the same for each, since RTAI saves
+  the same area whichever registers a task touched.
+
+  Usage: fpu_load
+
+  Start it right after loading fpu_bench. It returns 1 if anything was
+  corrupted while the FPU was being saved, which should never happen.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include <stdio.h>		/* printf() */
+#include <signal.h>		/* signal() */
+#include <sys/time.h>		/* gettimeofday() */
+#include <sys/mman.h>		/* PROT_READ, needed for rtai_shm.h */
+#include <sys/types.h>		/* off_t, needed for rtai_shm.h */
+#include <sys/fcntl.h>		/* O_RDWR, needed for rtai_shm.h */
+#include <rtai_shm.h>		/* rtai_malloc,free() */
+#include "fpu_bench.h"		/* FPU_BENCH, FPU_PHASE, FPU_SWITCH */
+
+#define LOAD_N 1000000
+#define LOAD_SUM 500000500000.0	/* 1 + 2 + ... + LOAD_N */
+
+static int done = 0;
+static void quit(int sig)
+{
+  done = 1;
+}
+
+static double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+int main(void)
+{
+  FPU_BENCH * bench;
+  FPU_SWITCH * sw0, * sw1;
+  FPU_PHASE * ph;
+  const char * state_name[] = FPU_STATE_NAMES;
+  int sums[FPU_BENCH_MAX_PHASES];
+  int bad[FPU_BENCH_MAX_PHASES];
+  double secs[FPU_BENCH_MAX_PHASES];
+  double a, s, start, rate, base;
+  int current, p, state;
+  int retval = 0;
+
+  signal(SIGINT, quit);
+
+  bench = rtai_malloc(FPU_BENCH_KEY, sizeof(FPU_BENCH));
+  if (0 == bench) {
+    fprintf(stderr, "can't allocate shared memory\n");
+    return 1;
+  }
+  if (bench->magic != FPU_BENCH_MAGIC ||
+      bench->version != FPU_BENCH_VERSION ||
+      bench->size != sizeof(FPU_BENCH)) {
+    fprintf(stderr, "no FPU benchmark, or its layout doesn't match; "
+	    "load fpu_bench first\n");
+    rtai_free(FPU_BENCH_KEY, bench);
+    return 1;
+  }
+
+  for (p = 0; p < FPU_BENCH_MAX_PHASES; p++) {
+    sums[p] = bad[p] = 0;
+    secs[p] = 0.0;
+  }
+
+  /*
+    Each sum goes to the phase that was running when it started, and
+    is thrown out if the phase changed before it finished.
+   */
+  while (! done && bench->current < bench->phases) {
+    current = bench->current;
+    start = now();
+    for (a = s = 0.0; a < LOAD_N; a += 1.0, s += a) ;
+    if (current < 0 || current != bench->current) {
+      continue;
+    }
+    secs[current] += now() - start;
+    sums[current]++;
+    if (s != LOAD_SUM) {
+      bad[current]++;
+    }
+  }
+  if (done) {
+    fprintf(stderr, "interrupted\n");
+    rtai_free(FPU_BENCH_KEY, bench);
+    return 1;
+  }
+
+  printf("context switches, %d round trips each\n", bench->sw[0][0].rounds);
+  printf("state  nsecs w/o fpu  nsecs w/ fpu  fpu cost  bad w/o fpu  bad w/ fpu\n");
+  for (state = 0; state < FPU_STATES; state++) {
+    sw0 = &bench->sw[0][state];
+    sw1 = &bench->sw[1][state];
+    if (sw0->switch_ns < 0) {
+      printf("%5s  not on this CPU\n", state_name[state]);
+      continue;
+    }
+    printf("%5s  %13d  %12d  %8d  %11d  %10d\n", state_name[state],
+	   sw0->switch_ns, sw1->switch_ns, sw1->switch_ns - sw0->switch_ns,
+	   sw0->bad, sw1->bad);
+    if (sw1->bad) retval = 1;
+  }
+
+  printf("\nperiodic task, %d msecs per phase\n", bench->phase_ms);
+  printf("state  period  fpu  rt cycles  rt bad  busy max  sums/sec  slowdown  bad sums\n");
+  base = 0.0;
+  for (p = 0; p < bench->phases; p++) {
+    ph = &bench->phase[p];
+    rate = (secs[p] > 0.0 ? sums[p] / secs[p] : 0.0);
+    if (0 == ph->period_us) {
+      base = rate;
+    }
+    printf("%5s  %6d  %3s  %9d  %6d  %8d  %8.0f  %7.1f%%  %8d\n",
+	   state_name[ph->state], ph->period_us, ph->use_fpu ? "yes" : "no", ph->cycles, ph->bad,
+	   ph->busy_max_ns, rate,
+	   base > 0.0 ? 100.0 * (base - rate) / base : 0.0, bad[p]);
+    if (ph->use_fpu && (ph->bad || bad[p])) retval = 1;
+  }
+
+  if (retval) {
+    printf("corrupted even with FPU save/restore\n");
+  }
+
+  rtai_free(FPU_BENCH_KEY, bench);
+
+  return retval;
+}
@@ -17,6 +17,10 @@
   Moral: you *must* enable the save/restore of the FPU in RT tasks that
   use it (e.g., if you have a 'double' anywhere, or call math library
   functions in <math.h>). 
+
+  Before it starts, the task also compares the array math functions in
+  vecmath.c with the RTAI math library, for accuracy and speed, if
+  MATH_BENCH is set, which it is by default.
 */
 
 #include <linux/kernel.h>
@@ -26,6 +30,7 @@
 #include <rtai.h>
 #include <rtai_sched.h>
 #include <rtai_math.h>
+#include "vecmath.h"
 
 /*
   Some newer versions define RT_SCHED_LOWEST_PRIORITY instead, so we'll
@@ -58,6 +63,127 @@ static int task_use_fpu = 1;	/* initially we enable FPU save/restore */
 
 #define SQ(x) ((x)*(x))		/* how to square a number */
 
+#define STACKSIZE 2048		/* room for rt_printk() in the benchmark */
+
+/*
+  The benchmark times BENCH_RUNS batches of BENCH_N values through each
+  of the vecmath.c functions, and through the same RTAI math function
+  called on each value in turn, and prints the fastest and slowest
+  batch of each. It also prints the biggest difference between them,
+  in units of the double precision epsilon, 2^-52, relative to the
+  value for exp(). printk() can't print doubles, so these are printed
+  as hundredths.
+ */
+int MATH_BENCH = 1;
+module_param(MATH_BENCH, int, 0);
+
+#define BENCH_N 256
+#define BENCH_RUNS 100
+#define EPSILON 2.220446049250313e-16
+
+static double bench_x[BENCH_N];
+static double bench_y[BENCH_N];
+static double bench_vec[BENCH_N];
+static double bench_ref[BENCH_N];
+
+typedef struct {
+  RTIME min;
+  RTIME max;
+} BENCH_TIME;
+
+static void bench_time_init(BENCH_TIME * bt)
+{
+  bt->min = 0;
+  bt->max = 0;
+}
+
+static void bench_time_add(BENCH_TIME * bt, RTIME ns)
+{
+  if (0 == bt->min || ns < bt->min) bt->min = ns;
+  if (ns > bt->max) bt->max = ns;
+}
+
+/*
+  bench_report() prints the times and the biggest error between the
+  two result arrays.
+ */
+static void bench_report(const char * name, BENCH_TIME * vec,
+			 BENCH_TIME * ref, int relative)
+{
+  double err, most = 0.0;
+  int t;
+
+  for (t = 0; t < BENCH_N; t++) {
+    err = fabs(bench_vec[t] - bench_ref[t]);
+    if (relative && bench_ref[t] != 0.0) {
+      err /= fabs(bench_ref[t]);
+    }
+    if (err > most) most = err;
+  }
+  most = most / EPSILON * 100.0;
+  if (most > 1.0e9) most = 1.0e9;
+
+  rt_printk("%s: max error %d.%02d eps\n", name,
+	    (int) most / 100, (int) most % 100);
+  rt_printk("%s: %d values vec %d..%d nsecs, rtai_math %d..%d nsecs\n",
+	    name, BENCH_N, (int) vec->min, (int) vec->max,
+	    (int) ref->min, (int) ref->max);
+}
+
+/*
+  BENCH() runs one function both ways, BENCH_RUNS times, the vecmath.c
+  one with 'VEC_CALL' and the rtai_math one with 'REF_CALL' for each
+  value 't'.
+ */
+#define BENCH(VEC_CALL, REF_CALL)		\
+  bench_time_init(&vec);			\
+  bench_time_init(&ref);			\
+  for (run = 0; run < BENCH_RUNS; run++) {	\
+    start = rt_get_cpu_time_ns();		\
+    VEC_CALL;					\
+    bench_time_add(&vec, rt_get_cpu_time_ns() - start);	\
+    start = rt_get_cpu_time_ns();		\
+    for (t = 0; t < BENCH_N; t++) {		\
+      REF_CALL;					\
+    }						\
+    bench_time_add(&ref, rt_get_cpu_time_ns() - start);	\
+  }
+
+static void math_bench(void)
+{
+  BENCH_TIME vec, ref;
+  RTIME start;
+  int run, t;
+
+  rt_printk("math bench: vecmath built for %s\n", vecmath_simd);
+
+  /* angles over several turns, and points all around the circle */
+  for (t = 0; t < BENCH_N; t++) {
+    bench_x[t] = (t - BENCH_N / 2) * 0.7853981 + 0.1 * t;
+    bench_y[t] = sin(0.37 * t) * (1 + t % 5);
+  }
+
+  BENCH(vec_sin(bench_x, bench_vec, BENCH_N),
+	bench_ref[t] = sin(bench_x[t]));
+  bench_report("sin", &vec, &ref, 0);
+
+  BENCH(vec_cos(bench_x, bench_vec, BENCH_N),
+	bench_ref[t] = cos(bench_x[t]));
+  bench_report("cos", &vec, &ref, 0);
+
+  BENCH(vec_atan2(bench_y, bench_x, bench_vec, BENCH_N),
+	bench_ref[t] = atan2(bench_y[t], bench_x[t]));
+  bench_report("atan2", &vec, &ref, 0);
+
+  /* exp() of the angles would overflow, so use -25.6..25.4 */
+  for (t = 0; t < BENCH_N; t++) {
+    bench_x[t] = (t - BENCH_N / 2) * 0.2;
+  }
+  BENCH(vec_exp(bench_x, bench_vec, BENCH_N),
+	bench_ref[t] = exp(bench_x[t]));
+  bench_report("exp", &vec, &ref, 1);
+}
+
 /*
   This task code runs at some nominal rate, unimportant, and increments
   the 'cum' cumulative count by 1. "1" here means computing the sine
@@ -77,6 +203,10 @@ static void task_code(int dummy)
   double arg;
   double increment;
 
+  if (MATH_BENCH) {
+    math_bench();
+  }
+
   next = rt_get_time() + nano2count(1e9);
   arg = 0.0;
   increment = 0.01;		/* 0.01 radians, about half a degree */
@@ -127,13 +257,23 @@ int init_module(void)
     printk("math test ok\n");
   }
 
+  /*
+    vecmath.c may have been built for SSE2 or AVX, so make sure we have
+    them before running it.
+   */
+  if (MATH_BENCH && vecmath_init()) {
+    printk("this CPU can't run vecmath built for %s, not benchmarking\n",
+	   vecmath_simd);
+    MATH_BENCH = 0;
+  }
+
   /*
     Note the passing of the 'task_use_fpu' flag here, which is initially
     1 to signify that we will be using floating point in this task.
     In the previous examples, we left this as 0 since we didn't use
     floating point.
    */
-  retval = rt_task_init(&math_task, task_code, 0, 1024, RT_LOWEST_PRIORITY,
+  retval = rt_task_init(&math_task, task_code, 0, STACKSIZE, RT_LOWEST_PRIORITY,
 			task_use_fpu,	/* uses floating point unit */
 			0);
   if (retval) {
@@ -0,0 +1,307 @@
+/*
+  vecmath.c
+
+  Math functions on arrays, for RT tasks that evaluate lots of them
+  each cycle.
+
+  Calling sin() in a loop costs a function call per value, and each
+  call takes a different path depending on the argument, so its time
+  varies. Here, each function is a loop whose body is straight-line
+  arithmetic, with no calls and no branches that depend on the values:
+  where there's a choice, both sides are computed and one is picked.
+  That makes the time per value the same for every value, and lets the
+  compiler vectorize the loops, doing 2 or more values at a time with
+  SSE2 or AVX. Build with 'make VECMATH_SIMD=sse2' or 'avx' for that;
+  by default the same code is built for the plain FPU.
+
+  The methods are the usual ones. Arguments are reduced to a small
+  range around 0, by subtracting the nearest multiple of pi/2 for the
+  trig functions or ln 2 for exp(), in pieces so no precision is lost,
+  and then a polynomial or ratio of polynomials does the rest. The
+  coefficients are the ones in the Cephes math library.
+
+  This is built without -ffast-math, which would let the compiler
+  rearrange the reductions and lose the precision they're careful to
+  keep. See the Makefile.
+*/
+
+/*
+  THIS SOFTWARE WAS PRODUCED BY EMPLOYEES OF THE U.S. GOVERNMENT AS PART
+  OF THEIR OFFICIAL DUTIES AND IS IN THE PUBLIC DOMAIN.
+*/
+
+#include "vecmath.h"
+
+#ifdef __KERNEL__
+#include <asm/cpufeature.h>	/* boot_cpu_has() */
+#endif
+
+#if defined(__AVX__)
+const char * vecmath_simd = "avx";
+#elif defined(__SSE2__)
+const char * vecmath_simd = "sse2";
+#else
+const char * vecmath_simd = "scalar";
+#endif
+
+int vecmath_init(void)
+{
+#if defined(__KERNEL__) && defined(__AVX__)
+#ifdef X86_FEATURE_AVX
+  if (! boot_cpu_has(X86_FEATURE_AVX)) return -1;
+#else
+  return -1;			/* kernel can't tell, so don't risk it */
+#endif
+#elif defined(__KERNEL__) && defined(__SSE2__)
+  if (! boot_cpu_has(X86_FEATURE_XMM2)) return -1;
+#endif
+
+  return 0;
+}
+
+/*
+  nearest() returns 'x' rounded to the nearest integer, as a double,
+  and puts it in 'k' as an integer too, for |x| < 2^51.
+
+  When the math is done in SSE registers, adding 1.5 * 2^52 pushes the
+  fraction off the end, and leaves the integer in the low bits, where
+  we can take it without converting, which SSE2 can't do two at a
+  time. The x87 FPU keeps extra bits, so there we convert, to 64 bits,
+  since converting anything past 2^31 to an int is undefined, and in
+  practice gives a huge negative number.
+ */
+#define ROUNDER 6755399441055744.0	/* 1.5 * 2^52 */
+#define ROUNDER_BITS 0x4338000000000000LL
+
+static inline double nearest(double x, long long * k)
+{
+#ifdef __SSE2_MATH__
+  union {
+    double d;
+    long long i;
+  } u;
+
+  u.d = x + ROUNDER;
+  *k = u.i - ROUNDER_BITS;
+
+  return u.d - ROUNDER;
+#else
+  double t = x + 0.5;
+  long long i = (long long) t;
+
+  i -= (t < (double) i);	/* this rounds toward 0; we want down */
+  *k = i;
+
+  return (double) i;
+#endif
+}
+
+/*
+  For sin and cos, pi/2 in three pieces, each short enough that
+  multiplying it by the quadrant number is exact.
+ */
+#define TWO_OVER_PI 6.36619772367581382433e-01
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624879595063154e-21
+
+/*
+  Angles are clamped to +/-2^50, so the quadrant number fits what
+  nearest() can do. Past there the answers are meaningless anyway,
+  but they're still a sine and cosine, between -1 and 1, rather than
+  whatever an overflow would make of them, which could upset anything
+  they feed, like a controller.
+ */
+#define TRIG_MAX 1125899906842624.0	/* 2^50 */
+
+/*
+  sincos1() puts the sine and cosine of 'x' in 's' and 'c'.
+ */
+static inline void sincos1(double x, double * s, double * c)
+{
+  long long k;
+  int q;
+  double kd, r, z, ps, pc, sn, cs;
+
+  x = x > TRIG_MAX ? TRIG_MAX : x < -TRIG_MAX ? -TRIG_MAX : x;
+
+  /* x = k pi/2 + r, |r| <= pi/4 */
+  kd = nearest(x * TWO_OVER_PI, &k);
+  r = ((x - kd * PIO2_1) - kd * PIO2_2) - kd * PIO2_3;
+  q = k & 3;
+
+  z = r * r;
+  ps = r + r * z * (((((1.58962301576546568060E-10 * z
+			- 2.50507477628578072866E-8) * z
+		       + 2.75573136213857245213E-6) * z
+		      - 1.98412698295895385996E-4) * z
+		     + 8.33333333332211858878E-3) * z
+		    - 1.66666666666666307295E-1);
+  pc = 1.0 - 0.5 * z + z * z * (((((-1.13585365213876817300E-11 * z
+				    + 2.08757008419747316778E-9) * z
+				   - 2.75573141792967388112E-7) * z
+				  + 2.48015872888517045348E-5) * z
+				 - 1.38888888888730564116E-3) * z
+				+ 4.16666666666665929218E-2);
+
+  /*
+    In odd quadrants sine and cosine trade places, and the signs go
+    around the quadrants as sin +, +, -, - and cos +, -, -, +.
+   */
+  sn = (q & 1) ? pc : ps;
+  cs = (q & 1) ? ps : pc;
+  *s = (q & 2) ? -sn : sn;
+  *c = ((q + 1) & 2) ? -cs : cs;
+}
+
+void vec_sin(const double * x, double * y, int n)
+{
+  double sv, cv;
+  int t;
+
+  for (t = 0; t < n; t++) {
+    sincos1(x[t], &sv, &cv);
+    y[t] = sv;
+  }
+}
+
+void vec_cos(const double * x, double * y, int n)
+{
+  double sv, cv;
+  int t;
+
+  for (t = 0; t < n; t++) {
+    sincos1(x[t], &sv, &cv);
+    y[t] = cv;
+  }
+}
+
+void vec_sincos(const double * x, double * s, double * c, int n)
+{
+  double sv, cv;
+  int t;
+
+  for (t = 0; t < n; t++) {
+    sincos1(x[t], &sv, &cv);
+    s[t] = sv;
+    c[t] = cv;
+  }
+}
+
+#define PI 3.14159265358979323846
+#define PI_2 1.57079632679489661923
+#define PI_4 7.85398163397448309616E-1
+#define TAN_3PI_8 0.66		/* where Cephes switches, near tan(3 pi/16) */
+#define MOREBITS 6.123233995736765886130E-17 /* pi/2 - PI_2 */
+
+/*
+  negative() is whether the sign bit of 'x' is set, which unlike x < 0
+  is true for -0, so atan2() gets the signs of zeros right. Copying the
+  sign is a single AND, which vectorizes where testing the bits as an
+  integer doesn't.
+ */
+static inline int negative(double x)
+{
+  return __builtin_copysign(1.0, x) < 0.0;
+}
+
+static inline double atan2_1(double y, double x)
+{
+  double ax, ay, mn, mx, a, t, tr, base, z, r;
+
+  /*
+    Work in the first octant, 0 <= a <= 1, and put it back after.
+   */
+  ax = x < 0.0 ? -x : x;
+  ay = y < 0.0 ? -y : y;
+  mn = ax < ay ? ax : ay;
+  mx = ax < ay ? ay : ax;
+  mx = mx > 0.0 ? mx : 1.0;	/* atan2(0, 0) is 0 */
+  a = mn / mx;
+
+  /*
+    Above 0.66, atan(a) = pi/4 + atan((a - 1)/(a + 1)). The division is
+    done either way, outside the choice, or the compiler won't
+    vectorize it, in case it traps.
+   */
+  tr = (a - 1.0) / (a + 1.0);
+  t = a > TAN_3PI_8 ? tr : a;
+  base = a > TAN_3PI_8 ? PI_4 + 0.5 * MOREBITS : 0.0;
+
+  z = t * t;
+  r = t + t * z * ((((-8.750608600031904122785E-1 * z
+		      - 1.615753718733365076637E1) * z
+		     - 7.500855792314704667340E1) * z
+		    - 1.228866684490136173410E2) * z
+		   - 6.485021904942025371773E1)
+    / (((((z + 2.485846490142306297962E1) * z
+	  + 1.650270098316988542046E2) * z
+	 + 4.328810604912902668951E2) * z
+	+ 4.853903996359136964868E2) * z
+       + 1.945506571482613964425E2);
+  r += base;
+
+  r = ay > ax ? (PI_2 - r) + MOREBITS : r;
+  r = negative(x) ? (PI - r) + 2.0 * MOREBITS : r;
+
+  return negative(y) ? -r : r;
+}
+
+void vec_atan2(const double * y, const double * x, double * a, int n)
+{
+  int t;
+
+  for (t = 0; t < n; t++) {
+    a[t] = atan2_1(y[t], x[t]);
+  }
+}
+
+/*
+  For exp, ln 2 in two pieces, like pi/2 above.
+ */
+#define LOG2E 1.4426950408889634073599
+#define LN2_HI 6.93145751953125E-1
+#define LN2_LO 1.42860682030941723212E-6
+#define EXP_MAX 709.0
+#define EXP_MIN -708.0
+
+static inline double exp1(double x)
+{
+  union {
+    double d;
+    long long i;
+  } scale;
+  long long k;
+  double kd, r, z, px, qx;
+
+  x = x > EXP_MAX ? EXP_MAX : x;
+  x = x < EXP_MIN ? EXP_MIN : x;
+
+  /* x = k ln 2 + r, |r| <= ln2 / 2, so exp(x) = 2^k exp(r) */
+  kd = nearest(x * LOG2E, &k);
+  r = (x - kd * LN2_HI) - kd * LN2_LO;
+
+  z = r * r;
+  px = r * ((1.26177193074810590878E-4 * z
+	     + 3.02994407707441961300E-2) * z
+	    + 9.99999999999999999910E-1);
+  qx = ((3.00198505138664455042E-6 * z
+	 + 2.52448340349684104192E-3) * z
+	+ 2.27265548208155028766E-1) * z
+    + 2.00000000000000000009E0;
+  r = 1.0 + 2.0 * px / (qx - px);
+
+  /* 2^k, made by putting k in the exponent bits */
+  scale.i = (k + 1023) << 52;
+
+  return r * scale.d;
+}
+
+void vec_exp(const double * x, double * y, int n)
+{
+  int t;
+
+  for (t = 0; t < n; t++) {
+    y[t] = exp1(x[t]);
+  }
+}
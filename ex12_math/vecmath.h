@@ -0,0 +1,47 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+/*
+  vecmath.h
+
+  Declarations for math functions that work on whole arrays at once,
+  for RT tasks that need many of them each cycle. Each takes 'n'
+  inputs and writes 'n' outputs, which may be the same array as the
+  input.
+
+  They're only for tasks that use the FPU, as set with rt_task_init()
+  or rt_task_use_fpu(). The time each takes depends only on 'n', not
+  on the values, so the worst case is the same as the average.
+ */
+
+/*
+  vec_sin(), vec_cos() and vec_sincos() are good to within an epsilon
+  or so for |x| up to about 1e6. Past that the error grows with |x|,
+  and past 1e9 they're no good, though they always stay between -1
+  and 1.
+ */
+extern void vec_sin(const double * x, double * y, int n);
+extern void vec_cos(const double * x, double * y, int n);
+extern void vec_sincos(const double * x, double * s, double * c, int n);
+
+/*
+  vec_atan2() puts the angle of each point (x[i], y[i]) in 'a', like
+  atan2(y[i], x[i]).
+ */
+extern void vec_atan2(const double * y, const double * x, double * a, int n);
+
+/*
+  vec_exp() saturates outside -708 to 709, where exp() would go out
+  of range.
+ */
+extern void vec_exp(const double * x, double * y, int n);
+
+/*
+  vecmath_simd is the instructions these were built for, "avx",
+  "sse2" or "scalar". vecmath_init() returns 0 if the CPU has them,
+  -1 if not, in which case the functions mustn't be used.
+ */
+extern const char * vecmath_simd;
+extern int vecmath_init(void);
+
+#endif /* VECMATH_H */
@@ -0,0 +1,209 @@
+#ifndef PORTIO_H
+#define PORTIO_H
+
+/*
+  portio.h
+
+  Output to I/O ports through a shadow copy of the register, for RT
+  tasks that set and clear bits on a port.
+
+  The usual way to change one bit on a port without disturbing the
+  others is to read the port with inb(), change the bit and write it
+  back with outb(). Reads of old ISA ports take about a microsecond,
+  which is a lot to spend in a task that's trying to make precise
+  edges. If nobody else changes the port, we can instead read it just
+  once, at init time, and after that keep our own copy, the "shadow",
+  and only ever write.
+
+  This doesn't work for ports that change by themselves, or that read
+  back something different from what was written, or that other code
+  writes to behind our back, so keep to the ports you own. For the
+  others, like the PC speaker port, 0x61, where the kernel's timer
+  and NMI code write other bits and bits 4 and 5 change by themselves,
+  use port_modify(), which reads the port before each write as usual,
+  but still gets the counting and tracing below.
+
+  Build with PORTIO_COUNT defined, e.g. 'make PORTIO_COUNT=1', to have
+  each PORT_REG count its reads and writes, to see what's saved.
+
+  Build with PORTIO_SIM defined to not touch the hardware at all,
+  with reads giving 0, and PORTIO_TRACE defined to record every write
+  with a timestamp in shared memory, for 'trace_app' to check the
+  timing. Together these let the examples be checked without a
+  scope, or even a port. Call portio_trace_init() before the first
+  port_init(), and portio_trace_exit() at the end; they do nothing
+  unless PORTIO_TRACE is defined. Since the trace buffer is declared
+  here, include this in just one file per module.
+*/
+
+#include <asm/io.h>		/* inb(), outb(), may be <sys/io.h> */
+
+#ifdef PORTIO_SIM
+#define PORTIO_IN(port) 0
+#define PORTIO_OUT(byte, port)
+#else
+#define PORTIO_IN(port) inb(port)
+#define PORTIO_OUT(byte, port) outb(byte, port)
+#endif
+
+#ifdef PORTIO_TRACE
+
+#include "rtai_sched.h"		/* rt_get_cpu_time_ns() */
+#include "rtai_shm.h"		/* rtai_kmalloc(), rtai_kfree() */
+#include "portio_trace.h"	/* PORTIO_LOG, PORTIO_RECORD */
+
+static PORTIO_LOG * portio_trace = 0;
+
+/*
+  portio_trace_init() allocates and clears the trace buffer. Returns
+  0 if OK, or -1 if there's no memory for it, in which case nothing
+  is recorded.
+ */
+static inline int portio_trace_init(void)
+{
+  portio_trace = rtai_kmalloc(PORTIO_TRACE_KEY, sizeof(PORTIO_LOG));
+  if (0 == portio_trace) {
+    return -1;
+  }
+  portio_trace->magic = PORTIO_TRACE_MAGIC;
+  portio_trace->version = PORTIO_TRACE_VERSION;
+  portio_trace->size = PORTIO_TRACE_LEN;
+  portio_trace->bytes = sizeof(PORTIO_LOG);
+  portio_trace->count = 0;
+
+  return 0;
+}
+
+static inline void portio_trace_exit(void)
+{
+  if (0 != portio_trace) {
+    rtai_kfree(PORTIO_TRACE_KEY);
+    portio_trace = 0;
+  }
+}
+
+static inline void portio_record(unsigned short port, unsigned char byte)
+{
+  PORTIO_RECORD * rec;
+  unsigned long flags;
+
+  if (0 != portio_trace) {
+    /*
+      More than one task may write ports, e.g. the simulated wand and
+      the task driving the LEDs, and one can preempt the other between
+      taking a slot and counting it, so they'd both fill the same one.
+      Holding off interrupts, on all CPUs, makes this one step.
+     */
+    flags = rt_global_save_flags_and_cli();
+    rec = &portio_trace->record[portio_trace->count % PORTIO_TRACE_LEN];
+    rec->ns = rt_get_cpu_time_ns();
+    rec->port = port;
+    rec->value = byte;
+    portio_trace->count++;
+    rt_global_restore_flags(flags);
+  }
+}
+
+#else
+
+#define portio_trace_init() 0
+#define portio_trace_exit()
+#define portio_record(port, byte)
+
+#endif /* PORTIO_TRACE */
+
+typedef struct {
+  unsigned short port;		/* the port address */
+  unsigned char shadow;		/* what we last wrote to it */
+#ifdef PORTIO_COUNT
+  unsigned long reads;		/* how many times we read the port */
+  unsigned long writes;		/* how many times we wrote it */
+#endif
+} PORT_REG;
+
+#ifdef PORTIO_COUNT
+#define PORTIO_COUNT_READ(r) ((r)->reads++)
+#define PORTIO_COUNT_WRITE(r) ((r)->writes++)
+#else
+#define PORTIO_COUNT_READ(r)
+#define PORTIO_COUNT_WRITE(r)
+#endif
+
+/*
+  port_init() sets up 'r' for 'port', reading the port once to start
+  the shadow off with what's there now.
+ */
+static inline void port_init(PORT_REG * r, unsigned short port)
+{
+  r->port = port;
+#ifdef PORTIO_COUNT
+  r->reads = 0;
+  r->writes = 0;
+#endif
+  r->shadow = PORTIO_IN(port);
+  PORTIO_COUNT_READ(r);
+  /* so the trace starts with what the port was */
+  portio_record(port, r->shadow);
+}
+
+/*
+  port_resync() reads the port again into the shadow, in case
+  something else changed it. This is the only other read.
+ */
+static inline void port_resync(PORT_REG * r)
+{
+  r->shadow = PORTIO_IN(r->port);
+  PORTIO_COUNT_READ(r);
+}
+
+/*
+  port_update() clears the bits in 'clear' and sets the bits in 'set',
+  with one write, so several bits can be changed at once. The rest
+  do their work through it.
+ */
+static inline void port_update(PORT_REG * r, unsigned char clear,
+			       unsigned char set)
+{
+  r->shadow = (r->shadow & ~clear) | set;
+  PORTIO_OUT(r->shadow, r->port);
+  PORTIO_COUNT_WRITE(r);
+  portio_record(r->port, r->shadow);
+}
+
+/*
+  port_modify() is port_update() for a port we share: it reads the
+  port first, so the bits we don't change are written back as they
+  are now, not as they were when we last looked.
+ */
+static inline void port_modify(PORT_REG * r, unsigned char clear,
+			       unsigned char set)
+{
+  port_resync(r);
+  port_update(r, clear, set);
+}
+
+static inline void port_set(PORT_REG * r, unsigned char mask)
+{
+  port_update(r, 0, mask);
+}
+
+static inline void port_clear(PORT_REG * r, unsigned char mask)
+{
+  port_update(r, mask, 0);
+}
+
+static inline void port_toggle(PORT_REG * r, unsigned char mask)
+{
+  port_update(r, r->shadow & mask, ~r->shadow & mask);
+}
+
+/* port_write() writes all the bits */
+static inline void port_write(PORT_REG * r, unsigned char byte)
+{
+  port_update(r, 0xFF, byte);
+}
+
+/* port_shadow() returns what's on the port, without reading it */
+#define port_shadow(r) ((r)->shadow)
+
+#endif /* PORTIO_H */
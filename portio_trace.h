@@ -0,0 +1,51 @@
+#ifndef PORTIO_TRACE_H
+#define PORTIO_TRACE_H
+
+/*
+  portio_trace.h
+
+  Layout of the port write trace, shared between RT tasks built with
+  PORTIO_TRACE, which record every port write through portio.h, and
+  the Linux 'trace_app' that analyzes them. It's in shared memory, so
+  it can be read while the tasks are running or after they're done,
+  as long as the module is still loaded.
+
+  The trace is a ring of PORTIO_TRACE_LEN records. 'count' is how many
+  have ever been written, so record 'count - 1' is the latest, in slot
+  '(count - 1) % size', and if 'count' is more than 'size' the oldest
+  have been written over.
+
+  The module may be 64-bit and the program reading the trace 32-bit,
+  so everything here has the same size and place in both: no 'long',
+  which is 32 bits in one and 64 in the other, and padding wherever a
+  'long long' would be lined up differently. 'bytes' is the size of
+  the whole thing, for the reader to check against its own. 'count'
+  is 32 bits, so it wraps around after 4 billion writes. That's days
+  of writing even at thousands a second, and since PORTIO_TRACE_LEN
+  divides 2^32 evenly, the slots are still right after it wraps; a
+  reader just sees fewer records for a while.
+*/
+
+#define PORTIO_TRACE_KEY 103	/* shared memory key, arbitrary */
+#define PORTIO_TRACE_MAGIC 0x50545243 /* "PTRC" */
+#define PORTIO_TRACE_VERSION 2
+#define PORTIO_TRACE_LEN 65536
+
+typedef struct {
+  long long ns;			/* when, from rt_get_cpu_time_ns() */
+  unsigned short port;		/* port address */
+  unsigned char value;		/* byte written */
+  unsigned char pad[5];		/* to 16 bytes, in 32 and 64 bits */
+} PORTIO_RECORD;
+
+typedef struct {
+  int magic;			/* PORTIO_TRACE_MAGIC */
+  int version;			/* PORTIO_TRACE_VERSION */
+  int size;			/* number of records, PORTIO_TRACE_LEN */
+  int bytes;			/* sizeof(PORTIO_LOG) */
+  volatile unsigned int count;	/* how many have been written */
+  int pad;			/* to 24 bytes, so 'record' lines up */
+  PORTIO_RECORD record[PORTIO_TRACE_LEN];
+} PORTIO_LOG;
+
+#endif /* PORTIO_TRACE_H */
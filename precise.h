@@ -0,0 +1,135 @@
+#ifndef PRECISE_H
+#define PRECISE_H
+
+/*
+  precise.h
+
+  Precise deadlines for RT tasks, by sleeping until a little before the
+  deadline and then busy-waiting until it arrives.
+
+  When a task sleeps until some time, it actually wakes up a bit
+  after it, by however long the timer interrupt and the scheduler
+  took. This "wakeup latency" varies from one wakeup to the next by up
+  to tens of microseconds, which is enough to see as chatter on a
+  servo or smearing on the LED wand. If we instead ask to wake up
+  early, by more than the latency, and spin on the clock for the
+  rest, we land on the deadline to within the time to read the clock.
+
+  The early-wake "margin" has to be bigger than the latency, but every
+  bit bigger is CPU time spent spinning, so we keep track of the
+  latency as we go and adjust the margin to the average plus four
+  times the average deviation, plus a little extra. If we still wake
+  up late, the margin goes up by what we missed by.
+
+  In one-shot mode, rt_get_time() reads the CPU time stamp counter, so
+  the spin is as fine as that. Don't use this in periodic mode, where
+  the time only changes with each timer tick.
+
+  Since these are declared static, include this in just one file per
+  module.
+*/
+
+#include "rtai.h"
+#include "rtai_sched.h"		/* rt_sleep_until(), rt_get_time() */
+
+typedef struct {
+  RTIME margin;			/* how early to wake, in counts */
+  RTIME guard;			/* extra on top of the estimate */
+  RTIME lat_avg;		/* average wakeup latency */
+  RTIME lat_dev;		/* average deviation of the latency */
+  RTIME lat_max;		/* worst wakeup latency */
+  RTIME late_max;		/* worst time past the deadline */
+  RTIME spin_max;		/* longest spin */
+  int count;			/* how many deadlines */
+  int late;			/* how many we woke up after */
+} PRECISE;
+
+/*
+  precise_init() sets up 'p' with an initial margin of 'margin_ns'
+  and a guard of 'guard_ns', both in nanoseconds.
+ */
+static inline void precise_init(PRECISE * p, RTIME margin_ns, RTIME guard_ns)
+{
+  p->margin = nano2count(margin_ns);
+  p->guard = nano2count(guard_ns);
+  p->lat_avg = 0;
+  p->lat_dev = p->margin >> 2;
+  p->lat_max = 0;
+  p->late_max = 0;
+  p->spin_max = 0;
+  p->count = 0;
+  p->late = 0;
+}
+
+/*
+  precise_sleep_until() returns at 'deadline', in counts, as closely as
+  it can, and returns how late it was, in counts.
+ */
+static inline RTIME precise_sleep_until(PRECISE * p, RTIME deadline)
+{
+  RTIME wake, now, latency, dev;
+
+  p->count++;
+
+  /*
+    Sleep until the margin before the deadline, if that's still ahead
+    of us, and see how late we woke up.
+   */
+  wake = deadline - p->margin;
+  now = rt_get_time();
+  if (wake > now) {
+    rt_sleep_until(wake);
+    now = rt_get_time();
+    latency = (now > wake ? now - wake : 0);
+    if (latency > p->lat_max) {
+      p->lat_max = latency;
+    }
+
+    /*
+      Update the running averages, weighting this one 1/8, and the
+      margin with them.
+     */
+    dev = (latency > p->lat_avg ? latency - p->lat_avg : p->lat_avg - latency);
+    p->lat_avg += (latency >> 3) - (p->lat_avg >> 3);
+    p->lat_dev += (dev >> 3) - (p->lat_dev >> 3);
+    p->margin = p->lat_avg + 4 * p->lat_dev + p->guard;
+  }
+
+  if (now > deadline) {
+    /* too late to spin, so make the margin bigger for next time */
+    p->late++;
+    p->margin += now - deadline;
+    if (now - deadline > p->late_max) {
+      p->late_max = now - deadline;
+    }
+    return now - deadline;
+  }
+
+  /*
+    Spin the rest of the way.
+   */
+  wake = now;
+  while (now < deadline) {
+    now = rt_get_time();
+  }
+  if (now - wake > p->spin_max) {
+    p->spin_max = now - wake;
+  }
+
+  return now - deadline;
+}
+
+/*
+  precise_report() prints the statistics, with 'name' for the
+  deadlines, from init_module() or cleanup_module().
+ */
+static inline void precise_report(PRECISE * p, const char * name)
+{
+  printk("%s: %d deadlines, %d late, by at most %d nsecs\n",
+	 name, p->count, p->late, (int) count2nano(p->late_max));
+  printk("%s: wakeup latency avg %d max %d, margin %d, spin max %d nsecs\n",
+	 name, (int) count2nano(p->lat_avg), (int) count2nano(p->lat_max),
+	 (int) count2nano(p->margin), (int) count2nano(p->spin_max));
+}
+
+#endif /* PRECISE_H */
@@ -0,0 +1,87 @@
+#ifndef PREFAULT_H
+#define PREFAULT_H
+
+/*
+  prefault.h
+
+  Taking the page faults on RTAI shared memory up front, for the Linux
+  side of the examples that read it.
+
+  On the real-time side, the memory from rtai_kmalloc() is already
+  resident in the kernel, and initializing it in init_module() touches
+  every page. On the Linux side, the first touch of each page can take
+  a page fault, which is exactly when we least want it. prefault()
+  takes these faults now, and page_faults() lets us see how many were
+  taken, before and after.
+
+  This is for Linux programs only, not kernel modules. Since these are
+  declared static, include this in just one file per program.
+*/
+
+#include <stddef.h>		/* size_t */
+#include <unistd.h>		/* sysconf() */
+#include <sys/mman.h>		/* mlock(), madvise() */
+#include <sys/time.h>		/* struct timeval, for getrusage() */
+#include <sys/resource.h>	/* getrusage() */
+
+/*
+  page_faults() returns how many page faults this process has taken
+  so far, or -1 if it can't tell.
+ */
+static long page_faults(void)
+{
+  struct rusage ru;
+
+  if (0 != getrusage(RUSAGE_SELF, &ru)) {
+    return -1;
+  }
+
+  return ru.ru_minflt + ru.ru_majflt;
+}
+
+/*
+  prefault() touches every page of 'ptr' so the page faults happen now,
+  locks the pages into memory, and if 'huge' is non-zero asks for huge
+  pages. It returns 0 if the pages were locked, non-zero if not, in
+  which case later page faults are still possible.
+ */
+static int prefault(void * ptr, size_t size, int huge)
+{
+  volatile char * cptr;
+  long pagesize;
+  size_t t;
+
+  /*
+    Huge pages need a huge-page-aligned region, and are only given
+    for some kinds of mappings. RTAI shared memory is mapped from
+    kernel pages, so this advice may be refused. That's not an error,
+    we just don't get the fewer TLB misses.
+   */
+  if (huge) {
+#ifdef MADV_HUGEPAGE
+    (void) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  /*
+    Read one byte from each page, which is enough to map it in.
+    Writing would clobber what the writer has put there.
+   */
+  pagesize = sysconf(_SC_PAGESIZE);
+  if (pagesize <= 0) {
+    pagesize = 4096;
+  }
+  cptr = ptr;
+  for (t = 0; t < size; t += pagesize) {
+    (void) cptr[t];
+  }
+  (void) cptr[size - 1];
+
+  /*
+    Lock the pages so they can't be paged out later. This takes
+    privileges or a big enough 'ulimit -l'.
+   */
+  return mlock(ptr, size);
+}
+
+#endif /* PREFAULT_H */
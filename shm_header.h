@@ -0,0 +1,118 @@
+#ifndef SHM_HEADER_H
+#define SHM_HEADER_H
+
+/*
+  shm_header.h
+
+  A header for the start of an RTAI shared memory segment, describing
+  what follows, so that a reader can check that it agrees with the
+  writer on the layout before using it.
+
+  Nothing in a shared memory key says what the memory holds, and
+  rtai_malloc() on the Linux side will happily hand back memory of
+  whatever size the RT side asked for, or zeroed memory if the RT side
+  isn't loaded yet. The header holds a magic number that says whose
+  memory it is, a version to bump when the layout changes, the size
+  of what follows, and a count of its elements, plus a 'ready' flag.
+
+  The writer fills in everything else first and sets 'ready' last,
+  with shm_header_ready(). The barrier there keeps the compiler from
+  moving the earlier stores after it. On x86, the CPU doesn't reorder
+  stores with other stores, so that's enough for a reader on another
+  CPU too. On cleanup, the writer clears 'ready' before freeing the
+  memory.
+
+  The reader waits for the magic number and 'ready' with
+  shm_header_wait(), since it may well be started before the writer,
+  and only then checks the rest with shm_header_check().
+*/
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>	/* barrier() */
+#else
+#include <unistd.h>		/* usleep() */
+#ifndef barrier
+#define barrier() __asm__ __volatile__ ("" : : : "memory")
+#endif
+#endif
+
+typedef struct {
+  unsigned int magic;		/* whose memory this is */
+  unsigned int version;		/* bump when the layout changes */
+  unsigned int size;		/* sizeof the data that follows */
+  unsigned int howmany;		/* number of data elements */
+  volatile int ready;		/* non-zero when the data is ready to read */
+} SHM_HEADER;
+
+/*
+  shm_header_init() describes the layout, with 'ready' still clear.
+ */
+static inline void shm_header_init(SHM_HEADER * header,
+				   unsigned int magic, unsigned int version,
+				   unsigned int size, unsigned int howmany)
+{
+  header->ready = 0;
+  header->magic = magic;
+  header->version = version;
+  header->size = size;
+  header->howmany = howmany;
+}
+
+/*
+  shm_header_ready() sets 'ready', after everything written before it.
+ */
+static inline void shm_header_ready(SHM_HEADER * header)
+{
+  barrier();
+  header->ready = 1;
+}
+
+/*
+  shm_header_check() returns 0 if the header matches the layout given,
+  -1 if it's not ours at all, and 1 if it's ours but of a different
+  version, size or number of elements.
+ */
+static inline int shm_header_check(SHM_HEADER * header,
+				   unsigned int magic, unsigned int version,
+				   unsigned int size, unsigned int howmany)
+{
+  if (header->magic != magic) {
+    return -1;
+  }
+
+  if (header->version != version ||
+      header->size != size ||
+      header->howmany != howmany) {
+    return 1;
+  }
+
+  return 0;
+}
+
+#ifndef __KERNEL__
+
+/*
+  shm_header_wait() waits up to 'msecs' milliseconds for the header to
+  have our 'magic' and say it's ready, and returns 0 if it did, -1 if
+  the magic never showed up, meaning the writer isn't loaded, and 1 if
+  it did but 'ready' never came. The barrier keeps the reads of the
+  data from being moved ahead of the read of 'ready'.
+ */
+static inline int shm_header_wait(SHM_HEADER * header, unsigned int magic, int msecs)
+{
+  int t;
+
+  for (t = 0; t < msecs; t += 10) {
+    if (header->magic == magic && header->ready) {
+      barrier();
+      return 0;
+    }
+    usleep(10000);
+  }
+
+  return header->magic == magic ? 1 : -1;
+}
+
+#endif /* __KERNEL__ */
+
+#endif /* SHM_HEADER_H */